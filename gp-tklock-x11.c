@@ -0,0 +1,187 @@
+/**
+   @file gp-tklock-x11.c
+
+   @brief Maemo systemui tklock plugin gp-tklock Xlib backend
+
+   Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+
+   This file is part of osso-systemui-tklock.
+
+   osso-systemui-tklock is free software;
+   you can redistribute it and/or modify it under the terms of the
+   GNU Lesser General Public License version 2.1 as published by the
+   Free Software Foundation.
+
+   osso-systemui-tklock is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with osso-systemui-powerkeymenu.
+   If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * gp_tklock only needs to own the grabs and see button and key events, so
+ * instead of a GtkWindow this backend uses a bare InputOnly window. Its events
+ * are taken straight from the X connection by a GDK filter, before GDK
+ * translates them and GTK marshals them to signal handlers.
+ */
+
+#include <gdk/gdkx.h>
+#include <gtk/gtk.h>
+#include <dbus/dbus.h>
+#include <syslog.h>
+#include <systemui.h>
+#include <X11/Xlib.h>
+
+#include "gp-tklock.h"
+#include "gp-tklock-x11.h"
+
+#define GP_TKLOCK_X11_SIZE 15
+
+static Display *
+gp_tklock_x11_display()
+{
+  return GDK_DISPLAY_XDISPLAY(gdk_display_get_default());
+}
+
+static GdkFilterReturn
+gp_tklock_x11_filter(GdkXEvent *gdk_xevent, GdkEvent *event, gpointer data)
+{
+  XEvent *xev = gdk_xevent;
+  gp_tklock_t *gp_tklock = data;
+  gint64 received = g_get_monotonic_time();
+
+  if (xev->xany.window != gp_tklock->xwindow)
+    return GDK_FILTER_CONTINUE;
+
+  switch (xev->type)
+  {
+    case MapNotify:
+      gp_tklock_mapped(gp_tklock);
+      break;
+    case ButtonPress:
+      gp_tklock_button_event(gp_tklock, TRUE, received);
+      break;
+    case ButtonRelease:
+      gp_tklock_button_event(gp_tklock, FALSE, received);
+      break;
+    case KeyPress:
+      gp_tklock_key_event(gp_tklock, xev->xkey.keycode,
+                          XLookupKeysym(&xev->xkey, 0), received);
+      break;
+    default:
+      break;
+  }
+
+  /* GDK doesn't know that window anyway */
+  return GDK_FILTER_REMOVE;
+}
+
+void
+gp_tklock_x11_create_window(gp_tklock_t *gp_tklock)
+{
+  Display *dpy = gp_tklock_x11_display();
+  XSetWindowAttributes attr;
+
+  SYSTEMUI_DEBUG_FN;
+
+  g_assert(gp_tklock != NULL && gp_tklock->xwindow == None);
+
+  attr.override_redirect = True;
+  attr.event_mask = ButtonPressMask | ButtonReleaseMask | KeyPressMask |
+      StructureNotifyMask;
+
+  gp_tklock->xwindow = XCreateWindow(
+        dpy, DefaultRootWindow(dpy), -GP_TKLOCK_X11_SIZE, -GP_TKLOCK_X11_SIZE,
+        GP_TKLOCK_X11_SIZE, GP_TKLOCK_X11_SIZE, 0, 0, InputOnly,
+        CopyFromParent, CWOverrideRedirect | CWEventMask, &attr);
+
+  if (gp_tklock->xwindow == None)
+  {
+    SYSTEMUI_ERROR("failed to create gp_tklock X window");
+    return;
+  }
+
+  XStoreName(dpy, gp_tklock->xwindow, "gp_tklock");
+  gdk_window_add_filter(NULL, gp_tklock_x11_filter, gp_tklock);
+}
+
+void
+gp_tklock_x11_destroy_window(gp_tklock_t *gp_tklock)
+{
+  SYSTEMUI_DEBUG_FN;
+
+  g_assert(gp_tklock != NULL);
+
+  if (gp_tklock->xwindow == None)
+    return;
+
+  gdk_window_remove_filter(NULL, gp_tklock_x11_filter, gp_tklock);
+  XDestroyWindow(gp_tklock_x11_display(), gp_tklock->xwindow);
+  gp_tklock->xwindow = None;
+}
+
+void
+gp_tklock_x11_show(gp_tklock_t *gp_tklock)
+{
+  Display *dpy = gp_tklock_x11_display();
+
+  SYSTEMUI_DEBUG_FN;
+
+  XMapRaised(dpy, gp_tklock->xwindow);
+  XFlush(dpy);
+}
+
+void
+gp_tklock_x11_hide(gp_tklock_t *gp_tklock)
+{
+  Display *dpy = gp_tklock_x11_display();
+
+  SYSTEMUI_DEBUG_FN;
+
+  XUnmapWindow(dpy, gp_tklock->xwindow);
+  XFlush(dpy);
+}
+
+gboolean
+gp_tklock_x11_grab(gp_tklock_t *gp_tklock)
+{
+  Display *dpy = gp_tklock_x11_display();
+
+  SYSTEMUI_DEBUG_FN;
+
+  if (XGrabPointer(dpy, gp_tklock->xwindow, False,
+                   ButtonPressMask | ButtonReleaseMask,
+                   GrabModeAsync, GrabModeAsync, None, None,
+                   CurrentTime) != GrabSuccess)
+  {
+    return FALSE;
+  }
+
+  if (XGrabKeyboard(dpy, gp_tklock->xwindow, True,
+                    GrabModeAsync, GrabModeAsync,
+                    CurrentTime) != GrabSuccess)
+  {
+    /* don't hold the pointer for a lock that doesn't have the keys */
+    XUngrabPointer(dpy, CurrentTime);
+    XFlush(dpy);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+void
+gp_tklock_x11_ungrab(gp_tklock_t *gp_tklock)
+{
+  Display *dpy = gp_tklock_x11_display();
+
+  SYSTEMUI_DEBUG_FN;
+
+  XUngrabPointer(dpy, CurrentTime);
+  XUngrabKeyboard(dpy, CurrentTime);
+  XFlush(dpy);
+}
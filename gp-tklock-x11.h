@@ -0,0 +1,42 @@
+/**
+   @file gp-tklock-x11.h
+
+   @brief Maemo systemui tklock plugin gp-tklock Xlib backend
+
+   Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+
+   This file is part of osso-systemui-tklock.
+
+   osso-systemui-tklock is free software;
+   you can redistribute it and/or modify it under the terms of the
+   GNU Lesser General Public License version 2.1 as published by the
+   Free Software Foundation.
+
+   osso-systemui-tklock is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with osso-systemui-powerkeymenu.
+   If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __GP_LOCK_X11_H_INCLUDED__
+#define __GP_LOCK_X11_H_INCLUDED__
+
+void gp_tklock_x11_create_window(gp_tklock_t *gp_tklock);
+void gp_tklock_x11_destroy_window(gp_tklock_t *gp_tklock);
+void gp_tklock_x11_show(gp_tklock_t *gp_tklock);
+void gp_tklock_x11_hide(gp_tklock_t *gp_tklock);
+gboolean gp_tklock_x11_grab(gp_tklock_t *gp_tklock);
+void gp_tklock_x11_ungrab(gp_tklock_t *gp_tklock);
+
+/* implemented in gp-tklock.c, shared by both backends */
+void gp_tklock_mapped(gp_tklock_t *gp_tklock);
+void gp_tklock_button_event(gp_tklock_t *gp_tklock, gboolean pressed,
+                            gint64 received);
+void gp_tklock_key_event(gp_tklock_t *gp_tklock, guint hw_key, guint keyval,
+                         gint64 received);
+
+#endif /* __GP_LOCK_X11_H_INCLUDED__ */
@@ -22,19 +22,66 @@
    If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <hildon/hildon.h>
+#include <gdk/gdkx.h>
+#include <gtk/gtk.h>
+#include <gconf/gconf-client.h>
 #include <dbus/dbus.h>
 #include <syslog.h>
 #include <systemui.h>
 #include <systemui/tklock-dbus-names.h>
 
 #include "gp-tklock.h"
+#include "gp-tklock-x11.h"
 #include "tklock-grab.h"
 
+#define GP_TKLOCK_XLIB_WINDOW "/system/systemui/tklock/xlib_grab_window"
+
 static guint try_grab_count = 0;
 
 #define GP_TKLOCK_EVENT_MASK (GDK_BUTTON_RELEASE_MASK | GDK_BUTTON_PRESS_MASK)
 
+static gboolean
+gp_tklock_grab(gp_tklock_t *gp_tklock, GdkWindow *confine_to)
+{
+  if (gp_tklock->xlib)
+    return gp_tklock_x11_grab(gp_tklock);
+
+  return tklock_grab_try(gp_tklock->window->window, FALSE,
+                         GP_TKLOCK_EVENT_MASK, confine_to);
+}
+
+static void
+gp_tklock_ungrab(gp_tklock_t *gp_tklock)
+{
+  if (gp_tklock->xlib)
+    gp_tklock_x11_ungrab(gp_tklock);
+  else
+    tklock_grab_release();
+}
+
+static void
+gp_tklock_grab_add(gp_tklock_t *gp_tklock)
+{
+  if (!gp_tklock->xlib)
+    gtk_grab_add(gp_tklock->window);
+}
+
+static void
+gp_tklock_grab_remove(gp_tklock_t *gp_tklock)
+{
+  if (!gp_tklock->xlib)
+    gtk_grab_remove(gp_tklock->window);
+}
+
+static void
+gp_tklock_hide(gp_tklock_t *gp_tklock)
+{
+  if (gp_tklock->xlib)
+    gp_tklock_x11_hide(gp_tklock);
+  else
+    gtk_widget_hide(gp_tklock->window);
+}
+
 static gboolean
 gp_tklock_try_grab(gpointer user_data)
 {
@@ -45,13 +92,12 @@ gp_tklock_try_grab(gpointer user_data)
 
   g_assert(gp_tklock != NULL);
 
-  tklock_grab_release();
+  gp_tklock_ungrab(gp_tklock);
 
-  if (try_grab_count)
+  if (try_grab_count && !gp_tklock->xlib)
     gtk_window_close_other_temporaries(GTK_WINDOW(gp_tklock->window));
 
-  if (!tklock_grab_try(gp_tklock->window->window, FALSE,
-                       GP_TKLOCK_EVENT_MASK, NULL))
+  if (!gp_tklock_grab(gp_tklock, NULL))
   {
     if (++try_grab_count > 3)
     {
@@ -70,14 +116,14 @@ gp_tklock_try_grab(gpointer user_data)
   {
     gp_tklock->grab_notify = 0;
     gp_tklock->grab_status = TKLOCK_GRAB_ENABLED;
-    gtk_grab_add(gp_tklock->window);
+    gp_tklock_grab_add(gp_tklock);
   }
 
   return rv;
 }
 
-static gboolean
-gp_tklock_map_cb(GtkWidget *widget, GdkEvent *event, gp_tklock_t *gp_tklock)
+void
+gp_tklock_mapped(gp_tklock_t *gp_tklock)
 {
   SYSTEMUI_DEBUG_FN;
 
@@ -91,8 +137,8 @@ gp_tklock_map_cb(GtkWidget *widget, GdkEvent *event, gp_tklock_t *gp_tklock)
     gp_tklock->grab_status = TKLOCK_GRAB_FAILED;
     gp_tklock->one_input = FALSE;
   }
-  else if (!tklock_grab_try(widget->window, FALSE, GP_TKLOCK_EVENT_MASK,
-                           gp_tklock->window->window) &&
+  else if (!gp_tklock_grab(gp_tklock, gp_tklock->xlib ?
+                             NULL : gp_tklock->window->window) &&
            !gp_tklock->grab_notify)
   {
     gp_tklock->grab_notify = g_timeout_add(200, gp_tklock_try_grab, gp_tklock);
@@ -100,8 +146,14 @@ gp_tklock_map_cb(GtkWidget *widget, GdkEvent *event, gp_tklock_t *gp_tklock)
   else
   {
     gp_tklock->grab_status = TKLOCK_GRAB_ENABLED;
-    gtk_grab_add(gp_tklock->window);
+    gp_tklock_grab_add(gp_tklock);
   }
+}
+
+static gboolean
+gp_tklock_map_cb(GtkWidget *widget, GdkEvent *event, gp_tklock_t *gp_tklock)
+{
+  gp_tklock_mapped(gp_tklock);
 
   return TRUE;
 }
@@ -126,37 +178,71 @@ gp_tklock_release_grabs(gp_tklock_t *gp_tklock)
   SYSTEMUI_DEBUG_FN;
 
   gp_tklock_remove_grab_notify(gp_tklock);
-  tklock_grab_release();
-  gtk_grab_remove(gp_tklock->window);
+  gp_tklock_ungrab(gp_tklock);
+  gp_tklock_grab_remove(gp_tklock);
+}
+
+/*
+ * Tell MCE about the input as early as possible. received is the monotonic
+ * time the event got to us, the latency runs until the handler has sent the
+ * systemui callback.
+ */
+static void
+gp_tklock_one_input_report(gp_tklock_t *gp_tklock, gint64 received)
+{
+  gint64 latency;
+
+  SYSTEMUI_DEBUG_FN;
+
+  if (gp_tklock->one_input_reported)
+    return;
+
+  gp_tklock->one_input_reported = TRUE;
+
+  if (!gp_tklock->one_input_mode_finished_handler)
+  {
+    SYSTEMUI_WARNING("one_input_mode_finished_handler wasn't registered, nop");
+    return;
+  }
+
+  gp_tklock->one_input_mode_finished_handler();
+
+  latency = g_get_monotonic_time() - received;
+
+  SYSTEMUI_DEBUG("one input reported %" G_GINT64_FORMAT " us after the event",
+                 latency);
+
+  gp_tklock->one_input_latency.count++;
+  gp_tklock->one_input_latency.total_us += latency;
+
+  if (latency > gp_tklock->one_input_latency.max_us)
+    gp_tklock->one_input_latency.max_us = latency;
 }
 
 static int
-ee_one_input_mode_finished(gp_tklock_t *gp_tklock)
+ee_one_input_mode_finished(gp_tklock_t *gp_tklock, gint64 received)
 {
   SYSTEMUI_DEBUG_FN;
 
   g_assert(gp_tklock != NULL);
-  g_assert(gp_tklock->window != NULL);
+  g_assert(gp_tklock_has_window(gp_tklock));
+
+  gp_tklock_one_input_report(gp_tklock, received);
 
   if (!gp_tklock->disabled)
   {
-    gtk_widget_hide(gp_tklock->window);
+    gp_tklock_hide(gp_tklock);
     gp_tklock->disabled = TRUE;
   }
 
-  if (!gp_tklock->one_input_mode_finished_handler)
-    SYSTEMUI_WARNING("one_input_mode_finished_handler wasn't registered, nop");
-  else
-    gp_tklock->one_input_mode_finished_handler();
-
   gp_tklock_release_grabs(gp_tklock);
 
   return 0;
 }
 
-static gboolean
-gp_tklock_button_release_event_cb(GtkWidget *widget, GdkEvent *event,
-                                  gp_tklock_t *gp_tklock)
+void
+gp_tklock_button_event(gp_tklock_t *gp_tklock, gboolean pressed,
+                       gint64 received)
 {
   SYSTEMUI_DEBUG_FN;
 
@@ -164,21 +250,42 @@ gp_tklock_button_release_event_cb(GtkWidget *widget, GdkEvent *event,
 
   if (gp_tklock->one_input)
   {
-    if (event->type == GDK_BUTTON_RELEASE)
+    if (!pressed)
     {
-      ee_one_input_mode_finished(gp_tklock);
+      ee_one_input_mode_finished(gp_tklock, received);
       gp_tklock->one_input_status = TKLOCK_ONE_INPUT_BUTTON_RELEASED;
     }
-    else if (event->type == GDK_BUTTON_PRESS)
+    else
+    {
       gp_tklock->one_input_status = TKLOCK_ONE_INPUT_BUTTON_PRESSED;
+
+      /*
+       * Report on press already, but keep the grab until release, so the
+       * release doesn't leak to the window below. tklock_close() leaves the
+       * grab alone while the button is down for the same reason.
+       */
+      gp_tklock_one_input_report(gp_tklock, received);
+    }
   }
+}
+
+static gboolean
+gp_tklock_button_release_event_cb(GtkWidget *widget, GdkEvent *event,
+                                  gp_tklock_t *gp_tklock)
+{
+  gint64 received = g_get_monotonic_time();
+
+  if (event->type == GDK_BUTTON_RELEASE)
+    gp_tklock_button_event(gp_tklock, FALSE, received);
+  else if (event->type == GDK_BUTTON_PRESS)
+    gp_tklock_button_event(gp_tklock, TRUE, received);
 
   return TRUE;
 }
 
-static gboolean
-gp_tklock_key_press_event_cb(GtkWidget *widget, GdkEventKey *event,
-                             gp_tklock_t *gp_tklock)
+void
+gp_tklock_key_event(gp_tklock_t *gp_tklock, guint hw_key, guint keyval,
+                    gint64 received)
 {
   SYSTEMUI_DEBUG_FN;
 
@@ -186,11 +293,9 @@ gp_tklock_key_press_event_cb(GtkWidget *widget, GdkEventKey *event,
   g_assert(gp_tklock->systemui_conn != NULL);
 
   if (gp_tklock->one_input)
-    ee_one_input_mode_finished(gp_tklock);
-  else if (event->type == GDK_KEY_PRESS && event->keyval != GDK_Execute)
+    ee_one_input_mode_finished(gp_tklock, received);
+  else if (keyval != GDK_Execute)
   {
-    dbus_uint32_t hw_key = event->hardware_keycode;
-
     if (hw_key == 73 ||  /* FK07 */
         hw_key == 74 ||  /* FK08 */
         hw_key == 121 || /* XF86AudioMute */
@@ -203,7 +308,8 @@ gp_tklock_key_press_event_cb(GtkWidget *widget, GdkEventKey *event,
         hw_key == 208 || /* XF86AudioPlay */
         hw_key == 209)   /* XF86AudioPause */
     {
-      dbus_uint32_t keyval = event->keyval;
+      dbus_uint32_t key = hw_key;
+      dbus_uint32_t val = keyval;
       DBusMessage *message = dbus_message_new_signal(TKLOCK_SIGNAL_PATH,
                                                      TKLOCK_SIGNAL_IF,
                                                      TKLOCK_MM_KEY_PRESS_SIG);
@@ -211,8 +317,8 @@ gp_tklock_key_press_event_cb(GtkWidget *widget, GdkEventKey *event,
       if (message)
       {
         if (dbus_message_append_args(message,
-                                     DBUS_TYPE_UINT32, &hw_key,
-                                     DBUS_TYPE_UINT32, &keyval,
+                                     DBUS_TYPE_UINT32, &key,
+                                     DBUS_TYPE_UINT32, &val,
                                      DBUS_TYPE_INVALID))
         {
           dbus_connection_send(gp_tklock->systemui_conn, message, NULL);
@@ -222,10 +328,34 @@ gp_tklock_key_press_event_cb(GtkWidget *widget, GdkEventKey *event,
       }
     }
   }
+}
+
+static gboolean
+gp_tklock_key_press_event_cb(GtkWidget *widget, GdkEventKey *event,
+                             gp_tklock_t *gp_tklock)
+{
+  g_assert(gp_tklock != NULL);
+
+  if (gp_tklock->one_input || event->type == GDK_KEY_PRESS)
+  {
+    gp_tklock_key_event(gp_tklock, event->hardware_keycode, event->keyval,
+                        g_get_monotonic_time());
+  }
 
   return TRUE;
 }
 
+gboolean
+gp_tklock_has_window(gp_tklock_t *gp_tklock)
+{
+  g_assert(gp_tklock != NULL);
+
+  if (gp_tklock->xlib)
+    return gp_tklock->xwindow != None;
+
+  return gp_tklock->window != NULL;
+}
+
 void
 gp_tklock_create_window(gp_tklock_t *gp_tklock)
 {
@@ -236,6 +366,12 @@ gp_tklock_create_window(gp_tklock_t *gp_tklock)
 
   g_assert(gp_tklock != NULL);
 
+  if (gp_tklock->xlib)
+  {
+    gp_tklock_x11_create_window(gp_tklock);
+    return;
+  }
+
   window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
   gp_tklock->window = window;
 
@@ -278,8 +414,14 @@ gp_tklock_enable_lock(gp_tklock_t *gp_tklock)
 
   if (gp_tklock->disabled)
   {
-    gtk_widget_show(gp_tklock->window);
-    gtk_window_move((GtkWindow *)gp_tklock->window, -15, -15);
+    if (gp_tklock->xlib)
+      gp_tklock_x11_show(gp_tklock);
+    else
+    {
+      gtk_widget_show(gp_tklock->window);
+      gtk_window_move((GtkWindow *)gp_tklock->window, -15, -15);
+    }
+
     gp_tklock->disabled = FALSE;
   }
 }
@@ -293,9 +435,18 @@ gp_tklock_init(DBusConnection *conn)
 
   if (gp_tklock)
   {
+    GConfClient *gc = gconf_client_get_default();
+
     g_assert(conn != NULL);
 
+    if (gc)
+    {
+      gp_tklock->xlib = gconf_client_get_bool(gc, GP_TKLOCK_XLIB_WINDOW, NULL);
+      g_object_unref(gc);
+    }
+
     gp_tklock->systemui_conn = conn;
+    gp_tklock->xwindow = None;
     gp_tklock_create_window(gp_tklock);
     gp_tklock->grab_status = TKLOCK_GRAB_DISABLED;
     gp_tklock->grab_notify = 0;
@@ -307,6 +458,31 @@ gp_tklock_init(DBusConnection *conn)
   return gp_tklock;
 }
 
+/*
+ * Repaint whatever the window covered on screen. It normally sits off-screen,
+ * so unlike invalidating the whole root window this is usually a no-op.
+ */
+static void
+gp_tklock_damage(gp_tklock_t *gp_tklock)
+{
+  GdkRectangle screen = {0, 0, gdk_screen_width(), gdk_screen_height()};
+  GdkRectangle rect;
+
+  /* InputOnly windows never leave anything on screen */
+  if (gp_tklock->xlib || !GTK_WIDGET_MAPPED(gp_tklock->window))
+    return;
+
+  gdk_window_get_frame_extents(gp_tklock->window->window, &rect);
+
+  if (gdk_rectangle_intersect(&rect, &screen, &rect))
+  {
+    gdk_error_trap_push();
+    gdk_window_invalidate_rect(GDK_ROOT_PARENT(), &rect, TRUE);
+    gdk_flush();
+    gdk_error_trap_pop();
+  }
+}
+
 void
 gp_tklock_disable_lock(gp_tklock_t *gp_tklock, gboolean release_gdk_grabs)
 {
@@ -321,21 +497,17 @@ gp_tklock_disable_lock(gp_tklock_t *gp_tklock, gboolean release_gdk_grabs)
     if (release_gdk_grabs)
       gp_tklock_release_grabs(gp_tklock);
     else
-      gtk_grab_remove(gp_tklock->window);
+      gp_tklock_grab_remove(gp_tklock);
 
     gp_tklock->grab_status = TKLOCK_GRAB_DISABLED;
   }
 
   if (!gp_tklock->disabled)
   {
-    gtk_widget_hide(gp_tklock->window);
+    gp_tklock_damage(gp_tklock);
+    gp_tklock_hide(gp_tklock);
     gp_tklock->disabled = TRUE;
   }
-
-  gdk_error_trap_push();
-  gdk_window_invalidate_rect(GDK_ROOT_PARENT(), NULL, TRUE);
-  gdk_flush();
-  gdk_error_trap_pop();
 }
 
 void
@@ -343,14 +515,34 @@ gp_tklock_destroy_lock(gp_tklock_t *gp_tklock)
 {
   SYSTEMUI_DEBUG_FN;
 
-  if (!gp_tklock)
+  if (!gp_tklock || !gp_tklock_has_window(gp_tklock))
     return;
 
   gp_tklock_disable_lock(gp_tklock, TRUE);
 
-  gtk_widget_unrealize(gp_tklock->window);
-  gtk_widget_destroy(gp_tklock->window);
-  gp_tklock->window = NULL;
+  if (gp_tklock->xlib)
+    gp_tklock_x11_destroy_window(gp_tklock);
+  else
+  {
+    gtk_widget_unrealize(gp_tklock->window);
+    gtk_widget_destroy(gp_tklock->window);
+    gp_tklock->window = NULL;
+  }
+}
+
+/*
+ * gp_tklock window is kept realized between locks, this drops it while it is
+ * not in use. It is re-created by the next gp_tklock_create_window().
+ */
+void
+gp_tklock_trim(gp_tklock_t *gp_tklock)
+{
+  SYSTEMUI_DEBUG_FN;
+
+  if (!gp_tklock || !gp_tklock_has_window(gp_tklock) || !gp_tklock->disabled)
+    return;
+
+  gp_tklock_destroy_lock(gp_tklock);
 }
 
 void
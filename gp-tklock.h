@@ -39,6 +39,13 @@ typedef enum
   TKLOCK_ONE_INPUT_BUTTON_RELEASED
 } tklock_one_input_status;
 
+typedef struct
+{
+  guint count;
+  gint64 total_us;
+  gint64 max_us;
+} tklock_latency_stats;
+
 typedef struct
 {
   GtkWidget *window;
@@ -46,18 +53,24 @@ typedef struct
   tklock_grab_status grab_status;
   gboolean one_input;
   tklock_one_input_status one_input_status;
+  gboolean one_input_reported;
+  tklock_latency_stats one_input_latency;
   void (*one_input_mode_finished_handler)();
   gulong btn_press_id;
   gulong btn_release_id;
   DBusConnection *systemui_conn;
   gboolean disabled;
+  gboolean xlib;
+  Window xwindow;
 } gp_tklock_t;
 
+gboolean gp_tklock_has_window(gp_tklock_t *gp_tklock);
 void gp_tklock_create_window(gp_tklock_t *gp_tklock);
 void gp_tklock_enable_lock(gp_tklock_t *gp_tklock);
 gp_tklock_t *gp_tklock_init(DBusConnection *conn);
 void gp_tklock_destroy_lock(gp_tklock_t *gp_tklock);
 void gp_tklock_disable_lock(gp_tklock_t *gp_tklock, gboolean release_gdk_grabs);
+void gp_tklock_trim(gp_tklock_t *gp_tklock);
 void gp_tklock_destroy(gp_tklock_t *gp_tklock);
 void gp_tklock_set_one_input_mode_handler(gp_tklock_t *gp_tklock,
                                           void (*handler)());
@@ -0,0 +1,389 @@
+/**
+   @file lpm-tklock.c
+
+   @brief Maemo systemui tklock plugin low power mode UI
+
+   Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+
+   This file is part of osso-systemui-tklock.
+
+   osso-systemui-tklock is free software;
+   you can redistribute it and/or modify it under the terms of the
+   GNU Lesser General Public License version 2.1 as published by the
+   Free Software Foundation.
+
+   osso-systemui-tklock is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with osso-systemui-powerkeymenu.
+   If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Low power mode UI: a small clock and the missed events counts on black.
+ * The window is override-redirect and its background is a plain black pixel,
+ * so the X server clears it without any client drawing. Everything we draw
+ * lives in a small content box, which is moved a few pixels every minute to
+ * avoid burn-in, and the union of its old and new position is the only area
+ * ever repainted. There is no background pixbuf, no slider and no database
+ * access, the event counts are the ones the visual tklock already has.
+ */
+
+#include <gtk/gtk.h>
+#include <systemui.h>
+
+#include <string.h>
+#include <time.h>
+
+#include "visual-tklock.h"
+#include "tklock-common.h"
+#include "lpm-tklock.h"
+
+#define LPM_TKLOCK_CONTENT_WIDTH 220
+#define LPM_TKLOCK_CONTENT_HEIGHT 84
+#define LPM_TKLOCK_CLOCK_FONT_SIZE 44
+#define LPM_TKLOCK_COUNT_FONT_SIZE 18
+#define LPM_TKLOCK_ICON_SIZE 24
+#define LPM_TKLOCK_EVENT_SPACING 12
+/* how far the content box wanders from the center, in pixels */
+#define LPM_TKLOCK_SHIFT 8
+
+static const GdkPoint lpm_tklock_shifts[] =
+{
+  {0, 0},
+  {LPM_TKLOCK_SHIFT, 0},
+  {LPM_TKLOCK_SHIFT, LPM_TKLOCK_SHIFT},
+  {0, LPM_TKLOCK_SHIFT},
+  {-LPM_TKLOCK_SHIFT, LPM_TKLOCK_SHIFT},
+  {-LPM_TKLOCK_SHIFT, 0},
+  {-LPM_TKLOCK_SHIFT, -LPM_TKLOCK_SHIFT},
+  {0, -LPM_TKLOCK_SHIFT},
+  {LPM_TKLOCK_SHIFT, -LPM_TKLOCK_SHIFT}
+};
+
+static void lpm_tklock_schedule_update(lpm_tklock_t *lpm_tklock);
+
+static void
+lpm_tklock_place_content(lpm_tklock_t *lpm_tklock)
+{
+  const GdkPoint *shift =
+      &lpm_tklock_shifts[lpm_tklock->shift % G_N_ELEMENTS(lpm_tklock_shifts)];
+
+  lpm_tklock->content.width = LPM_TKLOCK_CONTENT_WIDTH;
+  lpm_tklock->content.height = LPM_TKLOCK_CONTENT_HEIGHT;
+  lpm_tklock->content.x =
+      (gdk_screen_width() - LPM_TKLOCK_CONTENT_WIDTH) / 2 + shift->x;
+  lpm_tklock->content.y =
+      (gdk_screen_height() - LPM_TKLOCK_CONTENT_HEIGHT) / 2 + shift->y;
+}
+
+static void
+lpm_tklock_update(lpm_tklock_t *lpm_tklock)
+{
+  GdkRectangle dirty = lpm_tklock->content;
+
+  lpm_tklock->shift++;
+  lpm_tklock_place_content(lpm_tklock);
+  tklock_format_current_time(lpm_tklock->time_buf,
+                             sizeof(lpm_tklock->time_buf));
+
+  if (GTK_WIDGET_DRAWABLE(lpm_tklock->window))
+  {
+    gdk_rectangle_union(&dirty, &lpm_tklock->content, &dirty);
+    gdk_window_invalidate_rect(lpm_tklock->window->window, &dirty, FALSE);
+  }
+}
+
+static gboolean
+lpm_tklock_update_cb(gpointer user_data)
+{
+  lpm_tklock_t *lpm_tklock = user_data;
+
+  SYSTEMUI_DEBUG_FN;
+
+  lpm_tklock->update_id = 0;
+  lpm_tklock_update(lpm_tklock);
+  lpm_tklock_schedule_update(lpm_tklock);
+
+  return FALSE;
+}
+
+/* wake up on the minute boundary only, seconds are not shown */
+static void
+lpm_tklock_schedule_update(lpm_tklock_t *lpm_tklock)
+{
+  if (lpm_tklock->update_id || lpm_tklock->paused)
+    return;
+
+  lpm_tklock->update_id = g_timeout_add_seconds(60 - time(NULL) % 60,
+                                                lpm_tklock_update_cb,
+                                                lpm_tklock);
+}
+
+static void
+lpm_tklock_remove_update(lpm_tklock_t *lpm_tklock)
+{
+  if (lpm_tklock->update_id)
+  {
+    g_source_remove(lpm_tklock->update_id);
+    lpm_tklock->update_id = 0;
+  }
+}
+
+static PangoLayout *
+lpm_tklock_create_layout(GtkWidget *widget, const char *text, int size)
+{
+  PangoLayout *layout = gtk_widget_create_pango_layout(widget, text);
+  PangoFontDescription *font_desc = pango_font_description_new();
+
+  pango_font_description_set_family(font_desc, "Nokia Sans");
+  pango_font_description_set_absolute_size(font_desc, size * PANGO_SCALE);
+  pango_layout_set_font_description(layout, font_desc);
+  pango_font_description_free(font_desc);
+
+  return layout;
+}
+
+static void
+lpm_tklock_draw_events(lpm_tklock_t *lpm_tklock, cairo_t *cr, int y)
+{
+  PangoLayout *layouts[LPM_TKLOCK_EVENT_COUNT] = {NULL, };
+  PangoRectangle logical;
+  int width = 0;
+  int x;
+  int i;
+
+  for (i = 0; i < LPM_TKLOCK_EVENT_COUNT; i++)
+  {
+    char count[11];
+    int item;
+
+    if (!lpm_tklock->events[i] || !lpm_tklock->icons[i])
+      continue;
+
+    g_snprintf(count, sizeof(count), "%u", lpm_tklock->events[i]);
+    layouts[i] = lpm_tklock_create_layout(lpm_tklock->window, count,
+                                          LPM_TKLOCK_COUNT_FONT_SIZE);
+    pango_layout_get_pixel_extents(layouts[i], NULL, &logical);
+    item = LPM_TKLOCK_ICON_SIZE + 4 + logical.width;
+
+    if (width)
+      item += LPM_TKLOCK_EVENT_SPACING;
+
+    /* only what fits in the content box, the damage never covers more */
+    if (width + item > lpm_tklock->content.width)
+    {
+      g_object_unref(layouts[i]);
+      layouts[i] = NULL;
+      break;
+    }
+
+    width += item;
+  }
+
+  x = lpm_tklock->content.x + (lpm_tklock->content.width - width) / 2;
+
+  for (i = 0; i < LPM_TKLOCK_EVENT_COUNT; i++)
+  {
+    if (!layouts[i])
+      continue;
+
+    gdk_cairo_set_source_pixbuf(cr, lpm_tklock->icons[i], x, y);
+    cairo_paint_with_alpha(cr, 0.5);
+    x += LPM_TKLOCK_ICON_SIZE + 4;
+
+    pango_layout_get_pixel_extents(layouts[i], NULL, &logical);
+    cairo_set_source_rgb(cr, 0.5, 0.5, 0.5);
+    cairo_move_to(cr, x, y + (LPM_TKLOCK_ICON_SIZE - logical.height) / 2);
+    pango_cairo_show_layout(cr, layouts[i]);
+    x += logical.width + LPM_TKLOCK_EVENT_SPACING;
+
+    g_object_unref(layouts[i]);
+  }
+}
+
+static gboolean
+lpm_tklock_expose_cb(GtkWidget *widget, GdkEventExpose *event,
+                     lpm_tklock_t *lpm_tklock)
+{
+  PangoLayout *layout;
+  PangoRectangle logical;
+  cairo_t *cr;
+
+  /* outside of the content box there is nothing but background */
+  if (gdk_region_rect_in(event->region, &lpm_tklock->content) ==
+      GDK_OVERLAP_RECTANGLE_OUT)
+  {
+    return TRUE;
+  }
+
+  cr = gdk_cairo_create(widget->window);
+  gdk_cairo_region(cr, event->region);
+  cairo_clip(cr);
+  gdk_cairo_rectangle(cr, &lpm_tklock->content);
+  cairo_clip(cr);
+
+  layout = lpm_tklock_create_layout(widget, lpm_tklock->time_buf,
+                                    LPM_TKLOCK_CLOCK_FONT_SIZE);
+  pango_layout_get_pixel_extents(layout, NULL, &logical);
+
+  /* dim grey, lit pixels are what costs power */
+  cairo_set_source_rgb(cr, 0.5, 0.5, 0.5);
+  cairo_move_to(cr,
+                lpm_tklock->content.x +
+                (lpm_tklock->content.width - logical.width) / 2,
+                lpm_tklock->content.y);
+  pango_cairo_show_layout(cr, layout);
+  g_object_unref(layout);
+
+  lpm_tklock_draw_events(lpm_tklock, cr, lpm_tklock->content.y +
+                         LPM_TKLOCK_CONTENT_HEIGHT - LPM_TKLOCK_ICON_SIZE);
+
+  cairo_destroy(cr);
+
+  return TRUE;
+}
+
+static void
+lpm_tklock_create_window(lpm_tklock_t *lpm_tklock)
+{
+  GdkColor black = {0, 0, 0, 0};
+  GtkWidget *window;
+
+  SYSTEMUI_DEBUG_FN;
+
+  window = gtk_window_new(GTK_WINDOW_POPUP);
+  lpm_tklock->window = window;
+
+  gtk_window_set_title(GTK_WINDOW(window), "lpm_tklock");
+  gtk_widget_set_app_paintable(window, TRUE);
+  gtk_widget_modify_bg(window, GTK_STATE_NORMAL, &black);
+  gtk_window_move(GTK_WINDOW(window), 0, 0);
+  gtk_window_resize(GTK_WINDOW(window), gdk_screen_width(),
+                    gdk_screen_height());
+
+  g_signal_connect(window, "expose-event", G_CALLBACK(lpm_tklock_expose_cb),
+                   lpm_tklock);
+
+  gtk_widget_realize(window);
+}
+
+static void
+lpm_tklock_load_icons(lpm_tklock_t *lpm_tklock)
+{
+  int i;
+
+  for (i = 0; i < LPM_TKLOCK_EVENT_COUNT; i++)
+  {
+    if (!lpm_tklock->events[i] || lpm_tklock->icons[i])
+      continue;
+
+    lpm_tklock->icons[i] =
+        gtk_icon_theme_load_icon(gtk_icon_theme_get_default(),
+                                 tklock_get_icon_name(i),
+                                 LPM_TKLOCK_ICON_SIZE,
+                                 GTK_ICON_LOOKUP_NO_SVG, NULL);
+  }
+}
+
+lpm_tklock_t *
+lpm_tklock_new()
+{
+  SYSTEMUI_DEBUG_FN;
+
+  return g_slice_new0(lpm_tklock_t);
+}
+
+void
+lpm_tklock_show(lpm_tklock_t *lpm_tklock, const event_t *events)
+{
+  int i;
+
+  SYSTEMUI_DEBUG_FN;
+
+  g_assert(lpm_tklock != NULL);
+
+  for (i = 0; i < LPM_TKLOCK_EVENT_COUNT; i++)
+    lpm_tklock->events[i] = events ? events[i].count : 0;
+
+  if (!lpm_tklock->window)
+    lpm_tklock_create_window(lpm_tklock);
+
+  lpm_tklock_load_icons(lpm_tklock);
+  lpm_tklock_update(lpm_tklock);
+
+  if (!GTK_WIDGET_MAPPED(lpm_tklock->window))
+    gtk_widget_show(lpm_tklock->window);
+  else
+    gdk_window_invalidate_rect(lpm_tklock->window->window,
+                               &lpm_tklock->content, FALSE);
+
+  lpm_tklock_schedule_update(lpm_tklock);
+}
+
+void
+lpm_tklock_hide(lpm_tklock_t *lpm_tklock)
+{
+  SYSTEMUI_DEBUG_FN;
+
+  if (!lpm_tklock || !lpm_tklock->window)
+    return;
+
+  lpm_tklock_remove_update(lpm_tklock);
+  gtk_widget_hide(lpm_tklock->window);
+}
+
+/* nothing to update while the display is off */
+void
+lpm_tklock_set_paused(lpm_tklock_t *lpm_tklock, gboolean paused)
+{
+  if (!lpm_tklock || lpm_tklock->paused == paused)
+    return;
+
+  lpm_tklock->paused = paused;
+
+  if (paused)
+    lpm_tklock_remove_update(lpm_tklock);
+  else if (lpm_tklock->window && GTK_WIDGET_MAPPED(lpm_tklock->window))
+  {
+    lpm_tklock_update(lpm_tklock);
+    lpm_tklock_schedule_update(lpm_tklock);
+  }
+}
+
+void
+lpm_tklock_destroy_lock(lpm_tklock_t *lpm_tklock)
+{
+  int i;
+
+  SYSTEMUI_DEBUG_FN;
+
+  if (!lpm_tklock || !lpm_tklock->window)
+    return;
+
+  lpm_tklock_remove_update(lpm_tklock);
+  gtk_widget_destroy(lpm_tklock->window);
+  lpm_tklock->window = NULL;
+
+  for (i = 0; i < LPM_TKLOCK_EVENT_COUNT; i++)
+  {
+    if (lpm_tklock->icons[i])
+    {
+      g_object_unref(lpm_tklock->icons[i]);
+      lpm_tklock->icons[i] = NULL;
+    }
+  }
+}
+
+void
+lpm_tklock_destroy(lpm_tklock_t *lpm_tklock)
+{
+  if (!lpm_tklock)
+    return;
+
+  lpm_tklock_destroy_lock(lpm_tklock);
+  g_slice_free(lpm_tklock_t, lpm_tklock);
+}
@@ -0,0 +1,49 @@
+/**
+   @file lpm-tklock.h
+
+   @brief Maemo systemui tklock plugin low power mode UI
+
+   Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+
+   This file is part of osso-systemui-tklock.
+
+   osso-systemui-tklock is free software;
+   you can redistribute it and/or modify it under the terms of the
+   GNU Lesser General Public License version 2.1 as published by the
+   Free Software Foundation.
+
+   osso-systemui-tklock is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with osso-systemui-powerkeymenu.
+   If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __LPM_TKLOCK_H_INCLUDED__
+#define __LPM_TKLOCK_H_INCLUDED__
+
+#define LPM_TKLOCK_EVENT_COUNT 6
+
+typedef struct
+{
+  GtkWidget *window;
+  guint update_id;
+  gboolean paused;
+  guint shift;
+  GdkRectangle content;
+  char time_buf[64];
+  guint events[LPM_TKLOCK_EVENT_COUNT];
+  GdkPixbuf *icons[LPM_TKLOCK_EVENT_COUNT];
+} lpm_tklock_t;
+
+lpm_tklock_t *lpm_tklock_new();
+void lpm_tklock_show(lpm_tklock_t *lpm_tklock, const event_t *events);
+void lpm_tklock_hide(lpm_tklock_t *lpm_tklock);
+void lpm_tklock_set_paused(lpm_tklock_t *lpm_tklock, gboolean paused);
+void lpm_tklock_destroy_lock(lpm_tklock_t *lpm_tklock);
+void lpm_tklock_destroy(lpm_tklock_t *lpm_tklock);
+
+#endif /* __LPM_TKLOCK_H_INCLUDED__ */
@@ -28,12 +28,57 @@
 
 #include "gp-tklock.h"
 #include "visual-tklock.h"
+#include "lpm-tklock.h"
+
+#define TKLOCK_MODE_COUNT (TKLOCK_PAUSE_UI + 1)
+
+typedef enum {
+  /* nothing to reuse, create the target lock from scratch */
+  TKLOCK_ACTION_REBUILD,
+  /* target lock is already up, just refresh it */
+  TKLOCK_ACTION_REUSE,
+  /* hide the current lock, but keep it realized */
+  TKLOCK_ACTION_HIDE,
+  /* keep gp_tklock window, switch its mode and re-take the grabs */
+  TKLOCK_ACTION_REGRAB
+} tklock_transition_action;
+
+typedef struct {
+  guint count;
+  gint64 total_us;
+  gint64 max_us;
+} tklock_time_stats;
+
+typedef struct {
+  guint transition_count;
+  guint elided_teardowns;
+  tklock_time_stats unlock_roundtrip;
+  tklock_time_stats unlock_perceived;
+  guint unlocks_restored;
+  gint64 init_us;
+  /* first visual lock since plugin_init, and all the ones after it */
+  gint64 first_visual_us;
+  gboolean first_visual_prewarmed;
+  tklock_time_stats steady_visual;
+  /* what the locks leave behind, and what the retention policy freed */
+  vtklock_memory retention_peak;
+  vtklock_memory retention_released;
+  guint retention_trims;
+  /* dropped on memory pressure */
+  vtklock_memory pressure_released;
+  gsize pressure_sqlite_bytes;
+  guint pressure_events;
+  tklock_time_stats transitions[TKLOCK_MODE_COUNT][TKLOCK_MODE_COUNT];
+} tklock_stats;
 
 typedef struct {
   system_ui_data *data;
   system_ui_callback_t sysui_cb;
   gp_tklock_t *gp_tklock;
   vtklock_t *vtklock;
+  lpm_tklock_t *lpm_tklock;
+  tklock_mode mode;
+  tklock_stats stats;
 } tklock_plugin_data;
 
 #endif /* _SYSTEMUI_TKLOCK_PRIVATE_H */
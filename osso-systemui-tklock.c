@@ -23,7 +23,8 @@
 */
 
 #include <gdk/gdkx.h>
-#include <hildon/hildon.h>
+#include <gtk/gtk.h>
+#include <gconf/gconf-client.h>
 #include <mce/dbus-names.h>
 #include <mce/mode-names.h>
 #include <systemui.h>
@@ -34,18 +35,88 @@
 #include <syslog.h>
 
 #include "osso-systemui-tklock-priv.h"
+#include "tklock-display.h"
 #include "tklock-grab.h"
-
-#define DBUS_MCE_MATCH_RULE \
-  "type='signal',path='/com/nokia/mce/signal'," \
-  "interface='com.nokia.mce.signal'," \
-  "member='display_status_ind'"
+#include "tklock-prewarm.h"
+#include "tklock-pressure.h"
+#include "tklock-visual.h"
+
+#define TKLOCK_CLOSE_HYSTERESIS "/system/systemui/tklock/close_hysteresis"
+#define TKLOCK_CLOSE_HYSTERESIS_DEFAULT 100
+#define TKLOCK_OPTIMISTIC_UNLOCK "/system/systemui/tklock/optimistic_unlock"
+/* how long to wait for MCE to confirm an optimistic unlock, in ms */
+#define TKLOCK_OPTIMISTIC_UNLOCK_TIMEOUT 2000
+/*
+ * seconds the lock graphics are kept after the lock is gone, 0 drops them
+ * right away, unset or negative keeps them for the next lock
+ */
+#define TKLOCK_RETENTION "/system/systemui/tklock/retention"
+#define TKLOCK_RETENTION_WARM G_MAXUINT
 
 tklock_plugin_data *plugin_data = NULL;
 system_ui_callback_t system_ui_callback = {};
-static gboolean display_off = FALSE;
 static guint destroy_locks_id = 0;
+static guint close_teardown_id = 0;
+/* the mode MCE closed, the only one a pending teardown is elided for */
+static tklock_mode close_teardown_mode = TKLOCK_NONE;
+static guint close_hysteresis = TKLOCK_CLOSE_HYSTERESIS_DEFAULT;
 static Window ee_window = 0;
+static gboolean optimistic_unlock = FALSE;
+static guint optimistic_unlock_id = 0;
+static gint64 unlock_start = 0;
+static guint retention = TKLOCK_RETENTION_WARM;
+static guint retention_id = 0;
+
+
+static void
+tklock_time_stats_add(tklock_time_stats *stats, gint64 elapsed)
+{
+  stats->count++;
+  stats->total_us += elapsed;
+
+  if (elapsed > stats->max_us)
+    stats->max_us = elapsed;
+}
+
+static guint
+tklock_gconf_get_uint(const char *key, guint def)
+{
+  GConfClient *gc = gconf_client_get_default();
+  GConfValue *value;
+  guint rv = def;
+
+  if (!gc)
+    return def;
+
+  value = gconf_client_get(gc, key, NULL);
+
+  if (value)
+  {
+    if (value->type == GCONF_VALUE_INT && gconf_value_get_int(value) >= 0)
+      rv = gconf_value_get_int(value);
+
+    gconf_value_free(value);
+  }
+
+  g_object_unref(gc);
+
+  return rv;
+}
+
+static gboolean
+tklock_gconf_get_bool(const char *key)
+{
+  GConfClient *gc = gconf_client_get_default();
+  gboolean rv;
+
+  if (!gc)
+    return FALSE;
+
+  rv = gconf_client_get_bool(gc, key, NULL);
+  g_object_unref(gc);
+
+  return rv;
+}
 
 static void
 ee_create_window()
@@ -60,10 +131,15 @@ ee_create_window()
 
   SYSTEMUI_DEBUG_FN;
 
+  dpy = gdk_x11_display_get_xdisplay(gdk_display_get_default());
+
+  /* still there from a debounced close */
   if (ee_window)
+  {
+    XMapWindow(dpy, ee_window);
     return;
+  }
 
-  dpy = gdk_x11_display_get_xdisplay(gdk_display_get_default());
   screen = gdk_screen_get_default();
 
   XMatchVisualInfo(dpy, DefaultScreen(dpy), 32, VisualDepthMask, &vinfo);
@@ -90,16 +166,26 @@ ee_create_window()
     return;
   }
 
-  state = XInternAtom(dpy, "_NET_WM_STATE_FULLSCREEN", False);
-  XChangeProperty(dpy, ee_window, XInternAtom(dpy, "_NET_WM_STATE", False),
+  /* GDK caches the atoms, no round-trip once they are prewarmed */
+  state = gdk_x11_get_xatom_by_name("_NET_WM_STATE_FULLSCREEN");
+  XChangeProperty(dpy, ee_window, gdk_x11_get_xatom_by_name("_NET_WM_STATE"),
                   XA_ATOM, 32, PropModeReplace, (unsigned char *)&state, 1);
   XChangeProperty(dpy, ee_window,
-                  XInternAtom(dpy, "_HILDON_STACKING_LAYER", False),
+                  gdk_x11_get_xatom_by_name("_HILDON_STACKING_LAYER"),
                   XA_CARDINAL, 32, PropModeReplace, (unsigned char *)&layer, 1);
   XMapWindow(dpy, ee_window);
   XFreeColormap(dpy, cmap);
 }
 
+static void
+ee_hide_window()
+{
+  SYSTEMUI_DEBUG_FN;
+
+  if (ee_window)
+    XUnmapWindow(GDK_DISPLAY_XDISPLAY(gdk_display_get_default()), ee_window);
+}
+
 void
 ee_destroy_window()
 {
@@ -115,6 +201,117 @@ ee_destroy_window()
   }
 }
 
+static void
+tklock_memory_sample(vtklock_memory *mem)
+{
+  tklock_visual_get_memory(plugin_data->vtklock, mem);
+
+  /* InputOnly or 15x15, its bytes are not worth counting */
+  if (plugin_data->gp_tklock && gp_tklock_has_window(plugin_data->gp_tklock))
+    mem->windows++;
+
+  /* full screen ARGB, backed by the compositor while mapped */
+  if (ee_window)
+  {
+    GdkScreen *screen = gdk_screen_get_default();
+
+    mem->windows++;
+    mem->window_bytes += (gsize)gdk_screen_get_width(screen) *
+        gdk_screen_get_height(screen) * 4;
+  }
+}
+
+/* estimated from the pixmap and window sizes, not measured */
+static gsize
+tklock_memory_bytes(const vtklock_memory *mem)
+{
+  return mem->background + mem->decoded + mem->icons + mem->snapshot +
+      mem->window_bytes;
+}
+
+static void
+tklock_memory_released(vtklock_memory *released, const vtklock_memory *before,
+                       const vtklock_memory *after)
+{
+  released->background += before->background - after->background;
+  released->decoded += before->decoded - after->decoded;
+  released->icons += before->icons - after->icons;
+  released->snapshot += before->snapshot - after->snapshot;
+  released->windows += before->windows - after->windows;
+  released->window_bytes += before->window_bytes - after->window_bytes;
+}
+
+static gboolean
+tklock_retention_trim_cb(gpointer user_data)
+{
+  vtklock_memory before, after;
+
+  SYSTEMUI_DEBUG_FN;
+
+  retention_id = 0;
+
+  if (!plugin_data || plugin_data->mode != TKLOCK_NONE || close_teardown_id ||
+      destroy_locks_id)
+  {
+    return FALSE;
+  }
+
+  tklock_memory_sample(&before);
+  gp_tklock_trim(plugin_data->gp_tklock);
+  tklock_visual_trim(plugin_data->vtklock);
+  tklock_memory_sample(&after);
+  tklock_memory_released(&plugin_data->stats.retention_released, &before,
+                         &after);
+  plugin_data->stats.retention_trims++;
+
+  SYSTEMUI_NOTICE("retention trim, released an estimated %" G_GSIZE_FORMAT
+                  " B, %u windows", tklock_memory_bytes(&before) -
+                  tklock_memory_bytes(&after), before.windows - after.windows);
+
+  return FALSE;
+}
+
+static void
+tklock_retention_cancel()
+{
+  if (retention_id)
+  {
+    g_source_remove(retention_id);
+    retention_id = 0;
+  }
+}
+
+/* the locks are gone, apply the retention policy to what they left behind */
+static void
+tklock_retention_schedule()
+{
+  vtklock_memory mem;
+  vtklock_memory *peak = &plugin_data->stats.retention_peak;
+
+  SYSTEMUI_DEBUG_FN;
+
+  tklock_retention_cancel();
+  tklock_memory_sample(&mem);
+
+  peak->background = MAX(peak->background, mem.background);
+  peak->decoded = MAX(peak->decoded, mem.decoded);
+  peak->icons = MAX(peak->icons, mem.icons);
+  peak->snapshot = MAX(peak->snapshot, mem.snapshot);
+  peak->windows = MAX(peak->windows, mem.windows);
+  peak->window_bytes = MAX(peak->window_bytes, mem.window_bytes);
+
+  if (retention == TKLOCK_RETENTION_WARM)
+    return;
+
+  if (retention)
+  {
+    retention_id =
+        g_timeout_add_seconds(retention, tklock_retention_trim_cb, NULL);
+  }
+  else
+    tklock_retention_trim_cb(NULL);
+}
+
 static gboolean
 tklock_destroy_locks_cb(gpointer user_data)
 {
@@ -122,7 +319,7 @@ tklock_destroy_locks_cb(gpointer user_data)
 
   destroy_locks_id = 0;
 
-  if (display_off)
+  if (tklock_display_is_off())
     return FALSE;
 
   ee_destroy_window();
@@ -130,13 +327,17 @@ tklock_destroy_locks_cb(gpointer user_data)
   if (!plugin_data)
     return FALSE;
 
+  /* keep the window pooled, next tklock_open just maps it again */
   if (plugin_data->gp_tklock && !plugin_data->gp_tklock->disabled)
-    gp_tklock_destroy_lock(plugin_data->gp_tklock);
+    gp_tklock_disable_lock(plugin_data->gp_tklock, TRUE);
 
-  if (plugin_data->vtklock)
-    visual_tklock_destroy_lock(plugin_data->vtklock);
+  tklock_visual_destroy_lock(plugin_data->vtklock);
+
+  lpm_tklock_destroy_lock(plugin_data->lpm_tklock);
 
   systemui_free_callback(&plugin_data->sysui_cb);
+  plugin_data->mode = TKLOCK_NONE;
+  tklock_retention_schedule();
 
   return FALSE;
 }
@@ -153,13 +354,176 @@ tklock_destroy_locks_timeout_remove()
   }
 }
 
+static gboolean
+tklock_close_teardown_cb(gpointer user_data)
+{
+  SYSTEMUI_DEBUG_FN;
+
+  close_teardown_id = 0;
+
+  ee_destroy_window();
+
+  if (!plugin_data)
+    return FALSE;
+
+  tklock_visual_destroy_lock(plugin_data->vtklock);
+
+  lpm_tklock_destroy_lock(plugin_data->lpm_tklock);
+  tklock_retention_schedule();
+
+  return FALSE;
+}
+
+static void
+tklock_close_teardown_schedule(tklock_mode mode)
+{
+  SYSTEMUI_DEBUG_FN;
+
+  if (close_teardown_id)
+    g_source_remove(close_teardown_id);
+
+  close_teardown_mode = mode;
+
+  if (close_hysteresis)
+  {
+    close_teardown_id =
+        g_timeout_add(close_hysteresis, tklock_close_teardown_cb, NULL);
+  }
+  else
+    tklock_close_teardown_cb(NULL);
+}
+
+/*
+ * MCE re-opened the lock before the windows from the previous close were
+ * destroyed. If it is the same lock, reuse them. Otherwise nothing leads back
+ * to them until the next close, so drop whatever the new lock doesn't show.
+ */
+static void
+tklock_close_teardown_cancel(tklock_mode to)
+{
+  if (!close_teardown_id)
+    return;
+
+  g_source_remove(close_teardown_id);
+  close_teardown_id = 0;
+
+  if (to == close_teardown_mode)
+  {
+    plugin_data->stats.elided_teardowns++;
+    SYSTEMUI_NOTICE("close/open pair elided, %u so far",
+                    plugin_data->stats.elided_teardowns);
+    return;
+  }
+
+  SYSTEMUI_DEBUG("closed mode [%u] not reopened, tearing it down",
+                 close_teardown_mode);
+
+  if (to != TKLOCK_ENABLE)
+    ee_destroy_window();
+
+  if (to != TKLOCK_ENABLE_VISUAL)
+    tklock_visual_destroy_lock(plugin_data->vtklock);
+
+  if (to != TKLOCK_ENABLE_LPM_UI)
+    lpm_tklock_destroy_lock(plugin_data->lpm_tklock);
+}
+
+static void
+tklock_optimistic_unlock_timeout_remove()
+{
+  if (optimistic_unlock_id)
+  {
+    g_source_remove(optimistic_unlock_id);
+    optimistic_unlock_id = 0;
+  }
+}
+
+static gboolean
+tklock_optimistic_unlock_timeout_cb(gpointer user_data)
+{
+  SYSTEMUI_DEBUG_FN;
+
+  optimistic_unlock_id = 0;
+  unlock_start = 0;
+
+  /* MCE didn't close us, so the unlock was rejected, show the lock again */
+  SYSTEMUI_WARNING("unlock not confirmed by MCE, restoring visual tklock");
+
+  if (plugin_data && plugin_data->vtklock && plugin_data->vtklock->window &&
+      plugin_data->mode == TKLOCK_ENABLE_VISUAL)
+  {
+    tklock_visual_present_view(plugin_data->vtklock, tklock_display_is_off());
+    plugin_data->stats.unlocks_restored++;
+  }
+
+  return FALSE;
+}
+
+/* MCE answered the unlock, either with tklock_close or with a new open */
+static void
+tklock_unlock_finished(gboolean closed)
+{
+  gint64 elapsed;
+
+  if (!unlock_start)
+    return;
+
+  elapsed = g_get_monotonic_time() - unlock_start;
+  unlock_start = 0;
+
+  SYSTEMUI_DEBUG("MCE %s the lock %" G_GINT64_FORMAT " us after the unlock",
+                 closed ? "closed" : "reopened", elapsed);
+
+  if (closed)
+  {
+    tklock_time_stats_add(&plugin_data->stats.unlock_roundtrip, elapsed);
+
+    if (!optimistic_unlock)
+      tklock_time_stats_add(&plugin_data->stats.unlock_perceived, elapsed);
+  }
+  else if (optimistic_unlock_id)
+    plugin_data->stats.unlocks_restored++;
+
+  tklock_optimistic_unlock_timeout_remove();
+}
+
 static void
 vtklock_unlock_handler()
 {
+  vtklock_t *vtklock = plugin_data->vtklock;
+
   SYSTEMUI_DEBUG_FN;
 
   systemui_do_callback(plugin_data->data, &plugin_data->sysui_cb,
                        TKLOCK_UNLOCK);
+
+  /* both slider signals might report the same unlock */
+  if (unlock_start)
+    return;
+
+  unlock_start = g_get_monotonic_time();
+
+  /*
+   * Do not wait for the round-trip to MCE, the window is kept hidden, so the
+   * lock can be shown again right away if MCE doesn't close it
+   */
+  if (optimistic_unlock && vtklock)
+  {
+    gint64 elapsed;
+
+    tklock_visual_hide_lock(vtklock);
+    gdk_flush();
+
+    elapsed = g_get_monotonic_time() - unlock_start;
+    tklock_time_stats_add(&plugin_data->stats.unlock_perceived, elapsed);
+    SYSTEMUI_DEBUG("lock hidden %" G_GINT64_FORMAT " us after the unlock",
+                   elapsed);
+
+    tklock_optimistic_unlock_timeout_remove();
+    optimistic_unlock_id = g_timeout_add(TKLOCK_OPTIMISTIC_UNLOCK_TIMEOUT,
+                                         tklock_optimistic_unlock_timeout_cb,
+                                         NULL);
+  }
 }
 
 static void
@@ -174,44 +538,347 @@ gp_tklock_unlock_handler()
   systemui_free_callback(&plugin_data->sysui_cb);
 }
 
-static DBusHandlerResult
-display_status_cb(DBusConnection *connection, DBusMessage *message, void *data)
+static void
+display_status_cb(tklock_display_state state)
 {
   SYSTEMUI_DEBUG_FN;
 
-  if (dbus_message_is_signal(message, MCE_SIGNAL_IF, MCE_DISPLAY_SIG))
+  if (plugin_data)
+    lpm_tklock_set_paused(plugin_data->lpm_tklock, state == TKLOCK_DISPLAY_OFF);
+
+  if (state == TKLOCK_DISPLAY_OFF)
+    tklock_destroy_locks_timeout_remove();
+  else
   {
-    const char *status;
+    ee_destroy_window();
 
-    if (dbus_message_get_args(message, NULL,
-                              DBUS_TYPE_STRING, &status,
-                              DBUS_TYPE_INVALID))
-    {
-      SYSTEMUI_DEBUG("status '%s'", status);
+    if (plugin_data && plugin_data->vtklock)
+      tklock_visual_paint_deferred(plugin_data->vtklock);
+  }
+}
 
-      if (!strcmp(status, MCE_DISPLAY_OFF_STRING))
-      {
-        tklock_destroy_locks_timeout_remove();
-        display_off = TRUE;
-      }
-      else
-      {
-        display_off = FALSE;
-        ee_destroy_window();
-      }
+/*
+ * Give back everything that isn't part of the lock on screen, it is all
+ * rebuilt on demand by the next lock that needs it
+ */
+static void
+memory_pressure_cb()
+{
+  vtklock_memory before, after;
+  tklock_mode mode;
+  int sqlite_bytes;
+
+  SYSTEMUI_DEBUG_FN;
+
+  if (!plugin_data)
+    return;
+
+  mode = plugin_data->mode;
+  tklock_memory_sample(&before);
+  tklock_prewarm_cancel();
+
+  if (mode != TKLOCK_ENABLE)
+    ee_destroy_window();
+
+  if (mode != TKLOCK_ENABLE_VISUAL)
+    tklock_visual_destroy_lock(plugin_data->vtklock);
+
+  if (mode != TKLOCK_ENABLE_LPM_UI)
+    lpm_tklock_destroy_lock(plugin_data->lpm_tklock);
+
+  gp_tklock_trim(plugin_data->gp_tklock);
+  tklock_visual_trim(plugin_data->vtklock);
+
+  sqlite_bytes = tklock_visual_release_db_memory();
+
+  tklock_memory_sample(&after);
+  tklock_memory_released(&plugin_data->stats.pressure_released, &before,
+                         &after);
+  plugin_data->stats.pressure_sqlite_bytes += sqlite_bytes;
+  plugin_data->stats.pressure_events++;
+
+  SYSTEMUI_NOTICE("memory pressure, released an estimated %" G_GSIZE_FORMAT
+                  " B of images and windows (from their sizes, not RSS), "
+                  "%d B of sqlite cache",
+                  tklock_memory_bytes(&before) - tklock_memory_bytes(&after),
+                  sqlite_bytes);
+}
+
+/*
+ * Cheapest way to get from one lock mode to another. Pairs not listed are
+ * built from scratch.
+ */
+static const tklock_transition_action
+tklock_transitions[TKLOCK_MODE_COUNT][TKLOCK_MODE_COUNT] =
+{
+  [TKLOCK_ENABLE] =
+  {
+    [TKLOCK_ENABLE] = TKLOCK_ACTION_REUSE,
+    [TKLOCK_ONEINPUT] = TKLOCK_ACTION_REGRAB,
+    [TKLOCK_ENABLE_VISUAL] = TKLOCK_ACTION_HIDE,
+    [TKLOCK_ENABLE_LPM_UI] = TKLOCK_ACTION_REGRAB
+  },
+  [TKLOCK_ONEINPUT] =
+  {
+    [TKLOCK_ENABLE] = TKLOCK_ACTION_REGRAB,
+    [TKLOCK_ONEINPUT] = TKLOCK_ACTION_REGRAB,
+    [TKLOCK_ENABLE_VISUAL] = TKLOCK_ACTION_HIDE,
+    [TKLOCK_ENABLE_LPM_UI] = TKLOCK_ACTION_REGRAB
+  },
+  [TKLOCK_ENABLE_VISUAL] =
+  {
+    [TKLOCK_ENABLE] = TKLOCK_ACTION_HIDE,
+    [TKLOCK_ONEINPUT] = TKLOCK_ACTION_HIDE,
+    [TKLOCK_ENABLE_VISUAL] = TKLOCK_ACTION_REUSE,
+    [TKLOCK_ENABLE_LPM_UI] = TKLOCK_ACTION_HIDE
+  },
+  [TKLOCK_ENABLE_LPM_UI] =
+  {
+    [TKLOCK_ENABLE] = TKLOCK_ACTION_HIDE,
+    [TKLOCK_ONEINPUT] = TKLOCK_ACTION_HIDE,
+    [TKLOCK_ENABLE_VISUAL] = TKLOCK_ACTION_HIDE,
+    [TKLOCK_ENABLE_LPM_UI] = TKLOCK_ACTION_REUSE
+  }
+};
+
+static const char *
+tklock_mode_name(tklock_mode mode)
+{
+  switch (mode)
+  {
+    case TKLOCK_NONE:
+      return "none";
+    case TKLOCK_ENABLE:
+      return "enable";
+    case TKLOCK_ONEINPUT:
+      return "oneinput";
+    case TKLOCK_ENABLE_VISUAL:
+      return "visual";
+    case TKLOCK_ENABLE_LPM_UI:
+      return "lpm";
+    default:
+      return "unsupported";
+  }
+}
+
+static const char *
+tklock_action_name(tklock_transition_action action)
+{
+  switch (action)
+  {
+    case TKLOCK_ACTION_REBUILD:
+      return "rebuild";
+    case TKLOCK_ACTION_REUSE:
+      return "reuse";
+    case TKLOCK_ACTION_HIDE:
+      return "hide";
+    case TKLOCK_ACTION_REGRAB:
+      return "re-grab";
+  }
+
+  return "unknown";
+}
+
+static gp_tklock_t *
+tklock_get_gp_tklock()
+{
+  gp_tklock_t *gp_tklock = plugin_data->gp_tklock;
+
+  if (gp_tklock)
+  {
+    if (!gp_tklock_has_window(gp_tklock))
+      gp_tklock_create_window(gp_tklock);
+  }
+  else
+  {
+    gp_tklock = gp_tklock_init(plugin_data->data->system_bus);
+    plugin_data->gp_tklock = gp_tklock;
+  }
+
+  return gp_tklock;
+}
+
+static vtklock_t *
+tklock_get_vtklock()
+{
+  vtklock_t *vtklock = plugin_data->vtklock;
+
+  if (vtklock)
+  {
+    if (!vtklock->window)
+      tklock_visual_create_view(vtklock);
+  }
+  else
+  {
+    /* loads the visual lock module on first use, NULL if it is missing */
+    vtklock = tklock_visual_new(plugin_data->data->system_bus,
+                                vtklock_unlock_handler);
+    plugin_data->vtklock = vtklock;
+  }
+
+  return vtklock;
+}
+
+static lpm_tklock_t *
+tklock_get_lpm_tklock()
+{
+  if (!plugin_data->lpm_tklock)
+    plugin_data->lpm_tklock = lpm_tklock_new();
+
+  return plugin_data->lpm_tklock;
+}
+
+/* hide whatever lock is up in from, its window is kept for the way back */
+static void
+tklock_hide_current(tklock_mode from)
+{
+  if (from == TKLOCK_ENABLE_LPM_UI)
+    lpm_tklock_hide(plugin_data->lpm_tklock);
+  else
+    tklock_visual_hide_lock(plugin_data->vtklock);
+}
+
+static void
+tklock_enter_one_input(tklock_mode from, tklock_transition_action action)
+{
+  gp_tklock_t *gp_tklock;
+
+  SYSTEMUI_DEBUG_FN;
+
+  if (action == TKLOCK_ACTION_HIDE)
+    tklock_hide_current(from);
+
+  gp_tklock = tklock_get_gp_tklock();
+
+  if (!gp_tklock->one_input_mode_finished_handler)
+  {
+    gp_tklock_set_one_input_mode_handler(gp_tklock,
+                                         gp_tklock_unlock_handler);
+  }
+
+  gp_tklock->one_input = TRUE;
+  gp_tklock->one_input_status = TKLOCK_ONE_INPUT_DISABLED;
+  gp_tklock->one_input_reported = FALSE;
+  gp_tklock_enable_lock(gp_tklock);
+}
+
+static void
+tklock_enter_visual(tklock_mode from, tklock_transition_action action)
+{
+  vtklock_t *vtklock;
+
+  SYSTEMUI_DEBUG_FN;
+
+  ee_destroy_window();
+
+  vtklock = tklock_get_vtklock();
+
+  if (vtklock)
+    tklock_visual_present_view(vtklock, tklock_display_is_off());
+  else
+  {
+    /* no visual lock to show, at least keep the input locked */
+    gp_tklock_t *gp_tklock = tklock_get_gp_tklock();
+
+    SYSTEMUI_WARNING("visual tklock not available, using gp_tklock");
+    gp_tklock->one_input = FALSE;
+    gp_tklock->one_input_status = TKLOCK_ONE_INPUT_DISABLED;
+    gp_tklock_enable_lock(gp_tklock);
+  }
+
+  if (from == TKLOCK_ENABLE_LPM_UI)
+    lpm_tklock_hide(plugin_data->lpm_tklock);
+
+  /* vtklock has the grabs now, keep gp_tklock window for the way back */
+  if (action == TKLOCK_ACTION_HIDE && vtklock)
+  {
+    gp_tklock_t *gp_tklock = plugin_data->gp_tklock;
+
+    if (gp_tklock && gp_tklock_has_window(gp_tklock))
+    {
+      gp_tklock->one_input = FALSE;
+      gp_tklock->one_input_status = TKLOCK_ONE_INPUT_DISABLED;
+      gp_tklock_disable_lock(gp_tklock, FALSE);
     }
   }
+}
+
+static void
+tklock_enter_enable(tklock_mode from, tklock_transition_action action)
+{
+  gp_tklock_t *gp_tklock;
+
+  SYSTEMUI_DEBUG_FN;
+
+  if (from == TKLOCK_ONEINPUT)
+  {
+    systemui_do_callback(plugin_data->data, &plugin_data->sysui_cb,
+                         TKLOCK_CLOSED);
+  }
+  else if (action == TKLOCK_ACTION_HIDE)
+    tklock_hide_current(from);
+
+  ee_create_window();
+
+  gp_tklock = tklock_get_gp_tklock();
+  gp_tklock->one_input = FALSE;
+  gp_tklock_enable_lock(gp_tklock);
+
+  tklock_destroy_locks_timeout_remove();
+  destroy_locks_id = g_timeout_add_seconds(2, tklock_destroy_locks_cb, NULL);
+}
+
+/*
+ * gp_tklock keeps the grabs, so touches never reach whatever is below the
+ * low power mode UI
+ */
+static void
+tklock_enter_lpm(tklock_mode from, tklock_transition_action action)
+{
+  vtklock_t *vtklock = plugin_data->vtklock;
+  gp_tklock_t *gp_tklock;
+
+  SYSTEMUI_DEBUG_FN;
+
+  if (from == TKLOCK_ONEINPUT)
+  {
+    systemui_do_callback(plugin_data->data, &plugin_data->sysui_cb,
+                         TKLOCK_CLOSED);
+  }
 
-  return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+  /* a pending destroy from enable mode would take the grabs away */
+  tklock_destroy_locks_timeout_remove();
+  ee_destroy_window();
+
+  /*
+   * Missed events are the ones visual tklock read when it was shown, they
+   * are only current if that is the lock we come from. Older counts would be
+   * wrong, show none instead.
+   */
+  lpm_tklock_show(tklock_get_lpm_tklock(),
+                  from == TKLOCK_ENABLE_VISUAL && vtklock ?
+                    vtklock->event : NULL);
+
+  if (action == TKLOCK_ACTION_HIDE)
+    tklock_visual_hide_lock(vtklock);
+
+  gp_tklock = tklock_get_gp_tklock();
+  gp_tklock->one_input = FALSE;
+  gp_tklock->one_input_status = TKLOCK_ONE_INPUT_DISABLED;
+  gp_tklock_enable_lock(gp_tklock);
 }
 
 static int
 tklock_open(const char *interface, const char *method, GArray *args,
             system_ui_data *data, system_ui_handler_arg *out)
 {
-  static tklock_mode mode = TKLOCK_NONE;
   int supported_args[3] = {'u', 'b', 'b'};
   system_ui_handler_arg* hargs = ((system_ui_handler_arg *)args->data);
+  tklock_mode from = plugin_data->mode;
+  tklock_mode to;
+  tklock_transition_action action;
+  tklock_time_stats *stats;
+  gint64 start, elapsed;
 
   SYSTEMUI_DEBUG_FN;
 
@@ -223,105 +890,65 @@ tklock_open(const char *interface, const char *method, GArray *args,
   }
 
   SYSTEMUI_DEBUG("hargs[4].data.u32[%u]", hargs[4].data.u32);
-  SYSTEMUI_DEBUG("mode [%u]", mode);
+  SYSTEMUI_DEBUG("mode [%u]", from);
 
-  switch (hargs[4].data.u32)
-  {
-    case TKLOCK_ONEINPUT:
-    {
-      gp_tklock_t *gp_tklock = plugin_data->gp_tklock;
+  to = hargs[4].data.u32;
 
-      if (gp_tklock)
-      {
-        if (!gp_tklock->window)
-          gp_tklock_create_window(gp_tklock);
-      }
-      else
-      {
-        plugin_data->gp_tklock = gp_tklock_init(plugin_data->data->system_bus);
-        gp_tklock = plugin_data->gp_tklock;
-      }
+  if (to >= TKLOCK_MODE_COUNT)
+    return DBUS_TYPE_INVALID;
 
-      if (!gp_tklock->one_input_mode_finished_handler)
-      {
-        gp_tklock_set_one_input_mode_handler(gp_tklock,
-                                             gp_tklock_unlock_handler);
-      }
+  action = tklock_transitions[from][to];
+  start = g_get_monotonic_time();
 
-      gp_tklock->one_input = TRUE;
-      gp_tklock->one_input_status = TKLOCK_ONE_INPUT_DISABLED;
-      gp_tklock_enable_lock(gp_tklock);
-      mode = TKLOCK_ONEINPUT;
+  switch (to)
+  {
+    case TKLOCK_ONEINPUT:
+      tklock_enter_one_input(from, action);
       break;
-    }
     case TKLOCK_ENABLE_VISUAL:
-    {
-      vtklock_t *vtklock = plugin_data->vtklock;
-
-      ee_destroy_window();
-
-      if (vtklock)
-      {
-        if (!vtklock->window)
-          visual_tklock_create_view_whimsy(vtklock);
-      }
-      else
-      {
-        vtklock = visual_tklock_new(plugin_data->data->system_bus);
-        plugin_data->vtklock = vtklock;
-        visual_tklock_set_unlock_handler(vtklock, vtklock_unlock_handler);
-      }
-
-      visual_tklock_present_view(vtklock);
-
-      if (mode == TKLOCK_ENABLE)
-        gp_tklock_disable_lock(plugin_data->gp_tklock, FALSE);
-
-      mode = TKLOCK_ENABLE_VISUAL;
+      tklock_enter_visual(from, action);
       break;
-    }
     case TKLOCK_ENABLE:
-    {
-      gp_tklock_t *gp_tklock;
-
-      if (mode == TKLOCK_ONEINPUT)
-      {
-        systemui_do_callback(plugin_data->data, &plugin_data->sysui_cb,
-                             TKLOCK_CLOSED);
-      }
-      else if (mode == TKLOCK_ENABLE_VISUAL)
-      {
-        vtklock_t *vtklock = plugin_data->vtklock;
-
-        if (vtklock && vtklock->window)
-          visual_tklock_destroy_lock(vtklock);
-      }
+      tklock_enter_enable(from, action);
+      break;
+    case TKLOCK_ENABLE_LPM_UI:
+      tklock_enter_lpm(from, action);
+      break;
+    default:
+      return DBUS_TYPE_INVALID;
+  }
 
-      ee_create_window();
+  /* windows from a pending close were reused above */
+  tklock_close_teardown_cancel(to);
+  tklock_retention_cancel();
+  tklock_unlock_finished(FALSE);
 
-      gp_tklock = plugin_data->gp_tklock;
+  elapsed = g_get_monotonic_time() - start;
+  plugin_data->mode = to;
 
-      if (gp_tklock)
-      {
-        if (!gp_tklock->window)
-          gp_tklock_create_window(gp_tklock);
-      }
-      else
-        plugin_data->gp_tklock = gp_tklock_init(plugin_data->data->system_bus);
+  stats = &plugin_data->stats.transitions[from][to];
+  tklock_time_stats_add(stats, elapsed);
+  plugin_data->stats.transition_count++;
 
-      gp_tklock = plugin_data->gp_tklock;
-      gp_tklock->one_input = FALSE;
-      gp_tklock_enable_lock(gp_tklock);
-      mode = TKLOCK_ENABLE;
-      tklock_destroy_locks_timeout_remove();
-      destroy_locks_id =
-          g_timeout_add_seconds(2, tklock_destroy_locks_cb, NULL);
-      break;
+  if (to == TKLOCK_ENABLE_VISUAL && from != TKLOCK_ENABLE_VISUAL)
+  {
+    if (!plugin_data->stats.first_visual_us)
+    {
+      plugin_data->stats.first_visual_us = elapsed;
+      plugin_data->stats.first_visual_prewarmed = tklock_prewarm_done();
+      SYSTEMUI_NOTICE("first visual lock: %" G_GINT64_FORMAT " us (%s)",
+                      elapsed, plugin_data->stats.first_visual_prewarmed ?
+                        "prewarmed" : "cold");
     }
-    default:
-      return DBUS_TYPE_INVALID;
+    else
+      tklock_time_stats_add(&plugin_data->stats.steady_visual, elapsed);
   }
 
+  SYSTEMUI_DEBUG("%s -> %s (%s) took %" G_GINT64_FORMAT " us, "
+                 "transition %u", tklock_mode_name(from), tklock_mode_name(to),
+                 tklock_action_name(action), elapsed,
+                 plugin_data->stats.transition_count);
+
   if (check_set_callback(args, &plugin_data->sysui_cb))
     out->data.i32 = -3;
   else
@@ -349,15 +976,17 @@ tklock_close(const char *interface, const char *method, GArray *args,
   else
     silent = TRUE;
 
-  ee_destroy_window();
   tklock_destroy_locks_timeout_remove();
 
   if (!plugin_data)
   {
     SYSTEMUI_WARNING("tklock wasn't initialized, nop");
+    ee_destroy_window();
     return DBUS_TYPE_VARIANT;
   }
 
+  ee_hide_window();
+
   gp_tklock = plugin_data->gp_tklock;
 
   if (gp_tklock)
@@ -366,30 +995,51 @@ tklock_close(const char *interface, const char *method, GArray *args,
     SYSTEMUI_DEBUG("gp_tklock->one_input_status %d",
                    gp_tklock->one_input_status);
 
+    /*
+     * The input is reported on press already, so MCE won't close again
+     * after the release, don't wait for it
+     */
     if (gp_tklock->one_input)
     {
-      g_signal_handler_is_connected(gp_tklock->window, gp_tklock->btn_press_id);
-
-      if (gp_tklock->one_input_status != TKLOCK_ONE_INPUT_BUTTON_RELEASED ||
-          !silent)
+      if ((gp_tklock->one_input_status != TKLOCK_ONE_INPUT_BUTTON_RELEASED &&
+           !gp_tklock->one_input_reported) || !silent)
       {
         SYSTEMUI_DEBUG("Keeping systemui callback");
+        ee_destroy_window();
         return DBUS_TYPE_VARIANT;
       }
     }
 
-    gp_tklock->one_input_status = TKLOCK_ONE_INPUT_DISABLED;
-
     SYSTEMUI_DEBUG("gp_tklock->disabled %d", gp_tklock->disabled);
 
-    if (!gp_tklock->disabled)
-      gp_tklock_destroy_lock(gp_tklock);
+    /*
+     * MCE closes as soon as the press is reported. Without the grab the
+     * release would go to the window below, so leave it to the release to
+     * hide the window and ungrab, see ee_one_input_mode_finished()
+     */
+    if (gp_tklock->one_input &&
+        gp_tklock->one_input_status == TKLOCK_ONE_INPUT_BUTTON_PRESSED)
+    {
+      SYSTEMUI_DEBUG("button still down, keeping gp_tklock grabs");
+    }
+    else
+    {
+      gp_tklock->one_input_status = TKLOCK_ONE_INPUT_DISABLED;
+
+      /* gp_tklock window is pooled, just hide it and release the grabs */
+      if (!gp_tklock->disabled)
+        gp_tklock_disable_lock(gp_tklock, TRUE);
+    }
   }
 
-  if (plugin_data->vtklock)
-    visual_tklock_destroy_lock(plugin_data->vtklock);
+  tklock_visual_hide_lock(plugin_data->vtklock);
+
+  lpm_tklock_hide(plugin_data->lpm_tklock);
 
+  tklock_unlock_finished(TRUE);
   systemui_free_callback(&plugin_data->sysui_cb);
+  tklock_close_teardown_schedule(plugin_data->mode);
+  plugin_data->mode = TKLOCK_NONE;
 
   return DBUS_TYPE_VARIANT;
 }
@@ -397,6 +1047,8 @@ tklock_close(const char *interface, const char *method, GArray *args,
 static gboolean
 tklock_setup_plugin(system_ui_data *data)
 {
+  gint64 start = g_get_monotonic_time();
+
   SYSTEMUI_DEBUG_FN;
 
   plugin_data = g_slice_new0(tklock_plugin_data);
@@ -409,16 +1061,151 @@ tklock_setup_plugin(system_ui_data *data)
 
   plugin_data->data = data;
 
+  close_hysteresis = tklock_gconf_get_uint(TKLOCK_CLOSE_HYSTERESIS,
+                                           TKLOCK_CLOSE_HYSTERESIS_DEFAULT);
+  optimistic_unlock = tklock_gconf_get_bool(TKLOCK_OPTIMISTIC_UNLOCK);
+  retention = tklock_gconf_get_uint(TKLOCK_RETENTION, TKLOCK_RETENTION_WARM);
+
   systemui_add_handler(SYSTEMUI_TKLOCK_OPEN_REQ, tklock_open, data);
   systemui_add_handler(SYSTEMUI_TKLOCK_CLOSE_REQ, tklock_close, data);
 
-  dbus_connection_add_filter(data->system_bus, display_status_cb, NULL, NULL);
-  dbus_bus_add_match(data->system_bus, DBUS_MCE_MATCH_RULE, NULL);
+  if (!tklock_display_watcher_start(data->system_bus, display_status_cb))
+    SYSTEMUI_WARNING("display state won't be tracked");
+
+  tklock_prewarm_start();
+
+  if (!tklock_pressure_watcher_start(memory_pressure_cb))
+    SYSTEMUI_NOTICE("caches won't be dropped on memory pressure");
+
+  plugin_data->stats.init_us = g_get_monotonic_time() - start;
 
   return TRUE;
 }
 
-gboolean
+static void
+tklock_memory_dump(const char *what, const vtklock_memory *mem)
+{
+  SYSTEMUI_NOTICE("%s lock graphics, estimated: background %" G_GSIZE_FORMAT
+                  " B, decoded %" G_GSIZE_FORMAT " B, icons %" G_GSIZE_FORMAT
+                  " B, snapshot %" G_GSIZE_FORMAT " B, %u windows %"
+                  G_GSIZE_FORMAT " B", what, mem->background, mem->decoded,
+                  mem->icons, mem->snapshot, mem->windows, mem->window_bytes);
+}
+
+static void
+tklock_stats_dump()
+{
+  tklock_stats *stats = &plugin_data->stats;
+  vtklock_memory mem;
+  int from, to;
+
+  SYSTEMUI_NOTICE("%u lock mode transitions", stats->transition_count);
+  SYSTEMUI_NOTICE("%u close/open pairs elided by %u ms hysteresis",
+                  stats->elided_teardowns, close_hysteresis);
+
+  if (stats->unlock_roundtrip.count)
+  {
+    SYSTEMUI_NOTICE("unlock -> close round-trip: %u, avg %" G_GINT64_FORMAT
+                    " us, max %" G_GINT64_FORMAT " us",
+                    stats->unlock_roundtrip.count,
+                    stats->unlock_roundtrip.total_us /
+                    stats->unlock_roundtrip.count,
+                    stats->unlock_roundtrip.max_us);
+  }
+
+  if (stats->unlock_perceived.count)
+  {
+    SYSTEMUI_NOTICE("perceived unlock latency (%s): %u, avg %"
+                    G_GINT64_FORMAT " us, max %" G_GINT64_FORMAT " us, "
+                    "%u restored",
+                    optimistic_unlock ? "optimistic" : "round-trip",
+                    stats->unlock_perceived.count,
+                    stats->unlock_perceived.total_us /
+                    stats->unlock_perceived.count,
+                    stats->unlock_perceived.max_us,
+                    stats->unlocks_restored);
+  }
+
+  SYSTEMUI_NOTICE("plugin_init: %" G_GINT64_FORMAT " us", stats->init_us);
+
+  if (tklock_visual_load_time())
+  {
+    SYSTEMUI_NOTICE("visual lock module load: %" G_GINT64_FORMAT " us",
+                    tklock_visual_load_time());
+  }
+
+  if (stats->first_visual_us)
+  {
+    SYSTEMUI_NOTICE("first visual lock: %" G_GINT64_FORMAT " us (%s)",
+                    stats->first_visual_us, stats->first_visual_prewarmed ?
+                      "prewarmed" : "cold");
+  }
+
+  if (stats->steady_visual.count)
+  {
+    SYSTEMUI_NOTICE("visual locks after the first: %u, avg %" G_GINT64_FORMAT
+                    " us, max %" G_GINT64_FORMAT " us",
+                    stats->steady_visual.count,
+                    stats->steady_visual.total_us / stats->steady_visual.count,
+                    stats->steady_visual.max_us);
+  }
+
+  if (plugin_data->vtklock && plugin_data->vtklock->clock_ticks)
+  {
+    SYSTEMUI_NOTICE("clock ticks: %u, lock window size requests: %u",
+                    plugin_data->vtklock->clock_ticks,
+                    plugin_data->vtklock->size_requests);
+  }
+
+  tklock_memory_sample(&mem);
+  tklock_memory_dump("resident", &mem);
+  tklock_memory_dump("peak while hidden", &stats->retention_peak);
+
+  if (stats->retention_trims)
+  {
+    SYSTEMUI_NOTICE("retention policy %u s: %u trims", retention,
+                    stats->retention_trims);
+    tklock_memory_dump("released", &stats->retention_released);
+  }
+  else if (retention == TKLOCK_RETENTION_WARM)
+    SYSTEMUI_NOTICE("retention policy: keep warm");
+
+  if (stats->pressure_events)
+  {
+    SYSTEMUI_NOTICE("memory pressure events: %u, sqlite %" G_GSIZE_FORMAT
+                    " B", stats->pressure_events,
+                    stats->pressure_sqlite_bytes);
+    tklock_memory_dump("reclaimed under pressure", &stats->pressure_released);
+  }
+
+  if (plugin_data->gp_tklock && plugin_data->gp_tklock->one_input_latency.count)
+  {
+    tklock_latency_stats *l = &plugin_data->gp_tklock->one_input_latency;
+
+    SYSTEMUI_NOTICE("one input to callback latency: %u events, avg %"
+                    G_GINT64_FORMAT " us, max %" G_GINT64_FORMAT " us",
+                    l->count, l->total_us / l->count, l->max_us);
+  }
+
+  for (from = 0; from < TKLOCK_MODE_COUNT; from++)
+  {
+    for (to = 0; to < TKLOCK_MODE_COUNT; to++)
+    {
+      tklock_time_stats *ts = &stats->transitions[from][to];
+
+      if (!ts->count)
+        continue;
+
+      SYSTEMUI_NOTICE("%s -> %s (%s): %u times, avg %" G_GINT64_FORMAT
+                      " us, max %" G_GINT64_FORMAT " us",
+                      tklock_mode_name(from), tklock_mode_name(to),
+                      tklock_action_name(tklock_transitions[from][to]),
+                      ts->count, ts->total_us / ts->count, ts->max_us);
+    }
+  }
+}
+
+TKLOCK_EXPORT gboolean
 plugin_init(system_ui_data *data)
 {
   SYSTEMUI_DEBUG_FN;
@@ -434,7 +1221,7 @@ plugin_init(system_ui_data *data)
   return TRUE;
 }
 
-void
+TKLOCK_EXPORT void
 plugin_close(system_ui_data *data)
 {
   SYSTEMUI_DEBUG_FN;
@@ -448,8 +1235,27 @@ plugin_close(system_ui_data *data)
     systemui_remove_handler(SYSTEMUI_TKLOCK_CLOSE_REQ, data);
   }
 
+  tklock_display_watcher_stop();
+  tklock_pressure_watcher_stop();
+  tklock_prewarm_stop();
+  tklock_destroy_locks_timeout_remove();
+  tklock_optimistic_unlock_timeout_remove();
+  tklock_retention_cancel();
+  tklock_stats_dump();
+
+  if (close_teardown_id)
+  {
+    g_source_remove(close_teardown_id);
+    close_teardown_id = 0;
+  }
+
+  ee_destroy_window();
+
   gp_tklock_destroy_lock(plugin_data->gp_tklock);
-  visual_tklock_destroy_lock(plugin_data->vtklock);
+  tklock_visual_destroy(plugin_data->vtklock);
+  /* the module stays loaded, its caches would outlive the plugin */
+  tklock_visual_trim(NULL);
+  lpm_tklock_destroy(plugin_data->lpm_tklock);
 
   g_slice_free(tklock_plugin_data, plugin_data);
   plugin_data = NULL;
@@ -0,0 +1,372 @@
+/**
+   @file tklock-bake.c
+
+   @brief Maemo systemui tklock plugin lockslider background baking tool
+
+   Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+
+   This file is part of osso-systemui-tklock.
+
+   osso-systemui-tklock is free software;
+   you can redistribute it and/or modify it under the terms of the
+   GNU Lesser General Public License version 2.1 as published by the
+   Free Software Foundation.
+
+   osso-systemui-tklock is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with osso-systemui-powerkeymenu.
+   If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Package configure time tool: scales (and rotates) a lockslider PNG for a
+ * given screen size, converts it to the X server pixel format and writes it
+ * with a tklock_baked_header, see tklock-baked.c for the runtime side and
+ * tklock-bake.sh for the sizes it is run for.
+ *
+ * tklock-bake [-r] [-f rgb565|xrgb8888] SOURCE.png WIDTHxHEIGHT OUTPUT.raw
+ * tklock-bake -b SOURCE.png
+ *
+ * -r rotates the image clockwise first, as fill_background() does for fake
+ * portrait. The default format is rgb565, the one of the N900 X server.
+ *
+ * -b benchmarks the fused rotate and scale of tklock-scale.c against
+ * gdk_pixbuf_rotate_simple() and gdk_pixbuf_scale_simple() for a few common
+ * screen sizes, both orientations.
+ */
+
+#include <gdk/gdk.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "tklock-baked.h"
+#include "tklock-scale.h"
+
+#define BENCHMARK_RUNS 20
+
+/* 4x4 ordered dither, what gdk_draw_pixbuf() does for 16 bpp too */
+static const guint8 dither[4][4] =
+{
+  {0, 8, 2, 10},
+  {12, 4, 14, 6},
+  {3, 11, 1, 9},
+  {15, 7, 13, 5}
+};
+
+static guint
+dither_channel(guint v, guint bits, guint d)
+{
+  guint step = 1 << (8 - bits);
+
+  v += (d * step) / 16;
+
+  return MIN(v, 255) >> (8 - bits);
+}
+
+static void
+convert_rgb565(const guint8 *src, int n_channels, guint8 *dst, int x, int y)
+{
+  guint d = dither[y & 3][x & 3];
+  guint16 p = (dither_channel(src[0], 5, d) << 11) |
+      (dither_channel(src[1], 6, d) << 5) |
+      dither_channel(src[2], 5, d);
+
+  dst[0] = p & 0xff;
+  dst[1] = p >> 8;
+}
+
+static void
+convert_xrgb8888(const guint8 *src, int n_channels, guint8 *dst, int x, int y)
+{
+  dst[0] = src[2];
+  dst[1] = src[1];
+  dst[2] = src[0];
+  dst[3] = 0;
+}
+
+static void
+usage(const char *name)
+{
+  fprintf(stderr, "usage: %s [-r] [-f rgb565|xrgb8888] SOURCE.png "
+          "WIDTHxHEIGHT OUTPUT.raw\n", name);
+  fprintf(stderr, "       %s -b SOURCE.png\n", name);
+  exit(1);
+}
+
+static gint64
+benchmark_gdk(GdkPixbuf *src, int width, int height, gboolean rotate)
+{
+  gint64 start = g_get_monotonic_time();
+  int i;
+
+  for (i = 0; i < BENCHMARK_RUNS; i++)
+  {
+    GdkPixbuf *rotated = NULL;
+    GdkPixbuf *scaled;
+
+    if (rotate)
+      rotated = gdk_pixbuf_rotate_simple(src, GDK_PIXBUF_ROTATE_CLOCKWISE);
+
+    scaled = gdk_pixbuf_scale_simple(rotated ? rotated : src, width, height,
+                                     GDK_INTERP_BILINEAR);
+    g_object_unref(scaled);
+
+    if (rotated)
+      g_object_unref(rotated);
+  }
+
+  return (g_get_monotonic_time() - start) / BENCHMARK_RUNS;
+}
+
+static gint64
+benchmark_fused(GdkPixbuf *src, GdkPixbuf *dst, gboolean rotate,
+                gboolean simd)
+{
+  gint64 start = g_get_monotonic_time();
+  int i;
+
+  for (i = 0; i < BENCHMARK_RUNS; i++)
+    tklock_scale_rotate_into(src, dst, rotate, simd);
+
+  return (g_get_monotonic_time() - start) / BENCHMARK_RUNS;
+}
+
+static gboolean
+pixbuf_equal(GdkPixbuf *a, GdkPixbuf *b)
+{
+  int len = gdk_pixbuf_get_width(a) * gdk_pixbuf_get_n_channels(a);
+  int y;
+
+  for (y = 0; y < gdk_pixbuf_get_height(a); y++)
+  {
+    if (memcmp(gdk_pixbuf_get_pixels(a) + y * gdk_pixbuf_get_rowstride(a),
+               gdk_pixbuf_get_pixels(b) + y * gdk_pixbuf_get_rowstride(b),
+               len))
+    {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+static int
+benchmark(const char *file)
+{
+  static const struct
+  {
+    int width;
+    int height;
+  } sizes[] =
+  {
+    {800, 480},
+    {854, 480},
+    {960, 540},
+    {1280, 720},
+    {1920, 1080}
+  };
+  GError *error = NULL;
+  GdkPixbuf *src;
+  unsigned int i;
+  int rotate;
+
+#if !GLIB_CHECK_VERSION(2,36,0)
+  g_type_init();
+#endif
+
+  src = gdk_pixbuf_new_from_file(file, &error);
+
+  if (!src)
+  {
+    fprintf(stderr, "%s: %s\n", file, error->message);
+    return 1;
+  }
+
+  printf("source %dx%d, %d channels, simd: %s, %d runs each, us per run\n",
+         gdk_pixbuf_get_width(src), gdk_pixbuf_get_height(src),
+         gdk_pixbuf_get_n_channels(src), tklock_scale_simd_name(),
+         BENCHMARK_RUNS);
+  printf("%-10s %-8s %10s %10s %10s %s\n", "size", "rotate", "gdk", "scalar",
+         "simd", "simd == scalar");
+
+  for (i = 0; i < G_N_ELEMENTS(sizes); i++)
+  {
+    for (rotate = FALSE; rotate <= TRUE; rotate++)
+    {
+      /* rotated for a portrait screen of the same size */
+      int width = rotate ? sizes[i].height : sizes[i].width;
+      int height = rotate ? sizes[i].width : sizes[i].height;
+      GdkPixbuf *scalar = gdk_pixbuf_new(GDK_COLORSPACE_RGB,
+                                         gdk_pixbuf_get_has_alpha(src), 8,
+                                         width, height);
+      GdkPixbuf *simd = gdk_pixbuf_copy(scalar);
+      gint64 gdk_us = benchmark_gdk(src, width, height, rotate);
+      gint64 scalar_us = benchmark_fused(src, scalar, rotate, FALSE);
+      gint64 simd_us = benchmark_fused(src, simd, rotate, TRUE);
+      char size[32];
+
+      g_snprintf(size, sizeof(size), "%dx%d", width, height);
+      printf("%-10s %-8s %10" G_GINT64_FORMAT " %10" G_GINT64_FORMAT " %10"
+             G_GINT64_FORMAT " %s\n", size, rotate ? "yes" : "no", gdk_us,
+             scalar_us, simd_us, pixbuf_equal(scalar, simd) ? "yes" : "NO");
+
+      g_object_unref(scalar);
+      g_object_unref(simd);
+    }
+  }
+
+  g_object_unref(src);
+
+  return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+  void (*convert)(const guint8 *, int, guint8 *, int, int) = convert_rgb565;
+  tklock_baked_header hdr;
+  GdkPixbuf *pixbuf, *tmp;
+  GError *error = NULL;
+  gboolean rotated = FALSE;
+  const char *format = "rgb565";
+  gsize digest_len = sizeof(hdr.src_digest);
+  GChecksum *checksum;
+  gchar *data;
+  gsize len;
+  guint8 *row;
+  int width, height;
+  int x, y, opt;
+  FILE *f;
+
+  while ((opt = getopt(argc, argv, "brf:")) != -1)
+  {
+    if (opt == 'b')
+    {
+      if (argc - optind != 1)
+        usage(argv[0]);
+
+      return benchmark(argv[optind]);
+    }
+    else if (opt == 'r')
+      rotated = TRUE;
+    else if (opt == 'f')
+      format = optarg;
+    else
+      usage(argv[0]);
+  }
+
+  if (argc - optind != 3 ||
+      sscanf(argv[optind + 1], "%dx%d", &width, &height) != 2 ||
+      width <= 0 || height <= 0)
+  {
+    usage(argv[0]);
+  }
+
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.magic = TKLOCK_BAKED_MAGIC;
+  hdr.version = TKLOCK_BAKED_VERSION;
+  hdr.width = width;
+  hdr.height = height;
+  hdr.rotated = rotated;
+  hdr.byte_order = TKLOCK_BAKED_LSB_FIRST;
+
+  if (!strcmp(format, "rgb565"))
+  {
+    hdr.depth = 16;
+    hdr.bits_per_pixel = 16;
+    hdr.red_mask = 0xf800;
+    hdr.green_mask = 0x07e0;
+    hdr.blue_mask = 0x001f;
+  }
+  else if (!strcmp(format, "xrgb8888"))
+  {
+    hdr.depth = 24;
+    hdr.bits_per_pixel = 32;
+    hdr.red_mask = 0xff0000;
+    hdr.green_mask = 0x00ff00;
+    hdr.blue_mask = 0x0000ff;
+    convert = convert_xrgb8888;
+  }
+  else
+    usage(argv[0]);
+
+  /* rows padded to 32 bits, as XCreateImage() is told at load time */
+  hdr.stride = ((width * hdr.bits_per_pixel + 31) / 32) * 4;
+
+#if !GLIB_CHECK_VERSION(2,36,0)
+  g_type_init();
+#endif
+
+  if (!g_file_get_contents(argv[optind], &data, &len, &error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    return 1;
+  }
+
+  checksum = g_checksum_new(TKLOCK_BAKED_DIGEST);
+  g_checksum_update(checksum, (const guchar *)data, len);
+  g_checksum_get_digest(checksum, hdr.src_digest, &digest_len);
+  g_checksum_free(checksum);
+  g_free(data);
+
+  pixbuf = gdk_pixbuf_new_from_file(argv[optind], &error);
+
+  if (!pixbuf)
+  {
+    fprintf(stderr, "%s: %s\n", argv[optind], error->message);
+    return 1;
+  }
+
+  /* same as fill_background() */
+  if (rotated || gdk_pixbuf_get_width(pixbuf) != width ||
+      gdk_pixbuf_get_height(pixbuf) != height)
+  {
+    tmp = tklock_scale_rotate(pixbuf, width, height, rotated);
+    g_object_unref(pixbuf);
+    pixbuf = tmp;
+  }
+
+  f = fopen(argv[optind + 2], "wb");
+
+  if (!f)
+  {
+    perror(argv[optind + 2]);
+    return 1;
+  }
+
+  fwrite(&hdr, sizeof(hdr), 1, f);
+  row = g_malloc0(hdr.stride);
+
+  for (y = 0; y < height; y++)
+  {
+    const guint8 *src = gdk_pixbuf_get_pixels(pixbuf) +
+        y * gdk_pixbuf_get_rowstride(pixbuf);
+    int n_channels = gdk_pixbuf_get_n_channels(pixbuf);
+
+    for (x = 0; x < width; x++)
+    {
+      convert(src + x * n_channels, n_channels,
+              row + x * hdr.bits_per_pixel / 8, x, y);
+    }
+
+    fwrite(row, hdr.stride, 1, f);
+  }
+
+  g_free(row);
+  g_object_unref(pixbuf);
+
+  if (fclose(f))
+  {
+    perror(argv[optind + 2]);
+    return 1;
+  }
+
+  return 0;
+}
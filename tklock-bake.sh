@@ -0,0 +1,65 @@
+#!/bin/sh
+#
+# Bakes the lockslider backgrounds of a theme with tklock-bake for the screen
+# sizes below. The package runs it on configure and again when the theme
+# changes lockslider.png. The plugin decodes the PNG when there is no current
+# baked file for it, so a bake that failed or never ran only costs time.
+#
+# tklock-bake.sh [-r] [DIR]
+#
+# DIR is the theme backgrounds directory, the alpha theme by default. -r
+# removes the baked files instead. TKLOCK_BAKE can point at another
+# tklock-bake, ./tklock-bake for one in the source tree.
+
+TKLOCK_BAKE=${TKLOCK_BAKE:-/usr/lib/systemui/tklock/tklock-bake}
+
+# SIZE:FORMAT the portrait lockslider is baked for, 16 bpp for the OMAP3
+# panels, 24 bpp X servers above that
+PORTRAIT="480x800:rgb565 480x854:rgb565 540x960:xrgb8888 720x1280:xrgb8888"
+# the same, rotated for a landscape screen
+PORTRAIT_ROTATED="800x480:rgb565"
+# the landscape lockslider, it comes with the theme
+LANDSCAPE="800x480:rgb565 854x480:rgb565 960x540:xrgb8888 1280x720:xrgb8888"
+# the same, rotated for a portrait screen (forced fake portrait)
+LANDSCAPE_ROTATED="480x800:rgb565"
+
+set -e
+
+if [ "$1" = "-r" ]; then
+  remove=1
+  shift
+fi
+
+DIR=${1:-/usr/share/themes/alpha/backgrounds}
+
+if [ -n "$remove" ]; then
+  rm -f "$DIR"/lockslider*-[0-9]*x[0-9]*.raw
+  exit 0
+fi
+
+# bake NAME [-r] SIZES, NAME.png -> NAME[-rotated]-SIZE.raw as
+# tklock_baked_path() names them
+bake()
+{
+  name=$1
+  rotate=
+  suffix=
+
+  if [ "$2" = "-r" ]; then
+    rotate=-r
+    suffix=-rotated
+    shift
+  fi
+
+  [ -r "$DIR/$name.png" ] || return 0
+
+  for s in $2; do
+    $TKLOCK_BAKE $rotate -f ${s#*:} "$DIR/$name.png" ${s%:*} \
+      "$DIR/$name$suffix-${s%:*}.raw"
+  done
+}
+
+bake lockslider-portrait "$PORTRAIT"
+bake lockslider-portrait -r "$PORTRAIT_ROTATED"
+bake lockslider "$LANDSCAPE"
+bake lockslider -r "$LANDSCAPE_ROTATED"
@@ -0,0 +1,201 @@
+/**
+   @file tklock-baked.c
+
+   @brief Maemo systemui tklock plugin baked lockslider backgrounds
+
+   Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+
+   This file is part of osso-systemui-tklock.
+
+   osso-systemui-tklock is free software;
+   you can redistribute it and/or modify it under the terms of the
+   GNU Lesser General Public License version 2.1 as published by the
+   Free Software Foundation.
+
+   osso-systemui-tklock is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with osso-systemui-powerkeymenu.
+   If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Loads lockslider backgrounds baked at install time by tklock-bake: already
+ * scaled (and rotated) for the screen and stored in the X server pixel format,
+ * so the file is mapped and sent to a pixmap as it is. Anything that does not
+ * match exactly, be it the size, the visual or the source image, makes the
+ * caller fall back to decoding the PNG.
+ */
+
+#include <gtk/gtk.h>
+#include <gdk/gdkx.h>
+#include <systemui.h>
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tklock-baked.h"
+
+/* lockslider.png -> lockslider[-rotated]-800x480.raw, next to the PNG */
+gchar *
+tklock_baked_path(const char *png, gboolean rotated, gint width, gint height)
+{
+  gchar *base = g_strndup(png, g_str_has_suffix(png, ".png") ?
+                            strlen(png) - 4 : strlen(png));
+  gchar *path = g_strdup_printf("%s%s-%dx%d.raw", base,
+                                rotated ? "-rotated" : "", width, height);
+
+  g_free(base);
+
+  return path;
+}
+
+/* the PNG is about 100 kB, reading it is still far cheaper than decoding it */
+static gboolean
+tklock_baked_source_digest(const char *png, guint8 *digest)
+{
+  gsize digest_len = TKLOCK_BAKED_DIGEST_LEN;
+  GChecksum *checksum;
+  gchar *data;
+  gsize len;
+
+  if (!g_file_get_contents(png, &data, &len, NULL))
+    return FALSE;
+
+  checksum = g_checksum_new(TKLOCK_BAKED_DIGEST);
+  g_checksum_update(checksum, (const guchar *)data, len);
+  g_checksum_get_digest(checksum, digest, &digest_len);
+  g_checksum_free(checksum);
+  g_free(data);
+
+  return TRUE;
+}
+
+static gboolean
+tklock_baked_check(const tklock_baked_header *hdr, gsize len,
+                   const char *png, gboolean rotated, gint width,
+                   gint height, GdkVisual *visual)
+{
+  guint8 digest[TKLOCK_BAKED_DIGEST_LEN];
+
+  if (hdr->magic != TKLOCK_BAKED_MAGIC ||
+      hdr->version != TKLOCK_BAKED_VERSION)
+  {
+    SYSTEMUI_WARNING("not a baked background");
+    return FALSE;
+  }
+
+  if (hdr->width != (guint32)width || hdr->height != (guint32)height ||
+      hdr->rotated != (guint32)rotated ||
+      len < sizeof(*hdr) + (gsize)hdr->stride * hdr->height)
+  {
+    SYSTEMUI_WARNING("baked background geometry mismatch");
+    return FALSE;
+  }
+
+  if (hdr->depth != (guint32)visual->depth ||
+      hdr->red_mask != visual->red_mask ||
+      hdr->green_mask != visual->green_mask ||
+      hdr->blue_mask != visual->blue_mask)
+  {
+    SYSTEMUI_NOTICE("baked background is not in the screen pixel format");
+    return FALSE;
+  }
+
+  if (!tklock_baked_source_digest(png, digest) ||
+      memcmp(hdr->src_digest, digest, sizeof(digest)))
+  {
+    SYSTEMUI_NOTICE("baked background is older than its source");
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+GdkPixmap *
+tklock_baked_load(const char *png, gboolean rotated, gint width, gint height)
+{
+  gchar *path = tklock_baked_path(png, rotated, width, height);
+  GdkVisual *visual = gdk_visual_get_system();
+  GdkPixmap *pixmap = NULL;
+  tklock_baked_header *hdr;
+  struct stat st;
+  XImage *image;
+  GdkGC *gc;
+  void *map;
+  int fd;
+
+  SYSTEMUI_DEBUG_FN;
+
+  fd = open(path, O_RDONLY);
+
+  if (fd == -1)
+  {
+    SYSTEMUI_DEBUG("no baked background [%s]", path);
+    g_free(path);
+    return NULL;
+  }
+
+  if (fstat(fd, &st) ||
+      (gsize)st.st_size < sizeof(*hdr))
+    goto out;
+
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+  if (map == MAP_FAILED)
+  {
+    SYSTEMUI_WARNING("cannot map [%s]", path);
+    goto out;
+  }
+
+  hdr = map;
+
+  if (!tklock_baked_check(hdr, st.st_size, png, rotated, width, height,
+                          visual))
+  {
+    goto unmap;
+  }
+
+  image = XCreateImage(GDK_DISPLAY_XDISPLAY(gdk_display_get_default()),
+                       GDK_VISUAL_XVISUAL(visual), hdr->depth, ZPixmap, 0,
+                       (char *)(hdr + 1), width, height, 32, hdr->stride);
+
+  if (!image)
+    goto unmap;
+
+  if (image->bits_per_pixel == hdr->bits_per_pixel)
+  {
+    /* Xlib swaps the pixels if the server wants the other byte order */
+    image->byte_order = hdr->byte_order == TKLOCK_BAKED_MSB_FIRST ?
+          MSBFirst : LSBFirst;
+
+    pixmap = gdk_pixmap_new(gdk_get_default_root_window(), width, height,
+                            hdr->depth);
+    gc = gdk_gc_new(pixmap);
+    XPutImage(GDK_PIXMAP_XDISPLAY(pixmap), GDK_PIXMAP_XID(pixmap),
+              GDK_GC_XGC(gc), image, 0, 0, 0, 0, width, height);
+    g_object_unref(gc);
+  }
+  else
+    SYSTEMUI_NOTICE("baked background has %u bpp, screen %d bpp",
+                    hdr->bits_per_pixel, image->bits_per_pixel);
+
+  /* the data is the mapping, it is not ours to free */
+  image->data = NULL;
+  XDestroyImage(image);
+
+unmap:
+  munmap(map, st.st_size);
+
+out:
+  close(fd);
+  g_free(path);
+
+  return pixmap;
+}
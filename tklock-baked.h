@@ -0,0 +1,67 @@
+/**
+   @file tklock-baked.h
+
+   @brief Maemo systemui tklock plugin baked lockslider backgrounds
+
+   Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+
+   This file is part of osso-systemui-tklock.
+
+   osso-systemui-tklock is free software;
+   you can redistribute it and/or modify it under the terms of the
+   GNU Lesser General Public License version 2.1 as published by the
+   Free Software Foundation.
+
+   osso-systemui-tklock is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with osso-systemui-powerkeymenu.
+   If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __TKLOCK_BAKED_H__
+#define __TKLOCK_BAKED_H__
+
+#define TKLOCK_BAKED_MAGIC 0x4b42544bU /* "TKBK" */
+#define TKLOCK_BAKED_VERSION 2
+
+/* the source image checksum, src_digest */
+#define TKLOCK_BAKED_DIGEST G_CHECKSUM_MD5
+#define TKLOCK_BAKED_DIGEST_LEN 16
+
+/* byte_order */
+#define TKLOCK_BAKED_LSB_FIRST 0
+#define TKLOCK_BAKED_MSB_FIRST 1
+
+/*
+ * A baked background is this header followed by height rows of stride bytes
+ * of ZPixmap data, ready to be uploaded to a pixmap of the given depth. The
+ * source image checksum tells if the baked file is still current, its mtime
+ * can't, package builds clamp that to the changelog date.
+ */
+typedef struct
+{
+  guint32 magic;
+  guint32 version;
+  guint32 width;
+  guint32 height;
+  guint32 stride;
+  guint32 depth;
+  guint32 bits_per_pixel;
+  guint32 red_mask;
+  guint32 green_mask;
+  guint32 blue_mask;
+  guint32 byte_order;
+  guint32 rotated;
+  guint8 src_digest[TKLOCK_BAKED_DIGEST_LEN];
+} tklock_baked_header;
+
+gchar *tklock_baked_path(const char *png, gboolean rotated, gint width,
+                         gint height);
+GdkPixmap *tklock_baked_load(const char *png, gboolean rotated, gint width,
+                             gint height);
+
+#endif /* __TKLOCK_BAKED_H__ */
@@ -0,0 +1,687 @@
+/**
+   @file tklock-clock.c
+
+   @brief Maemo systemui tklock plugin fixed-extent lock clock
+
+   Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+
+   This file is part of osso-systemui-tklock.
+
+   osso-systemui-tklock is free software;
+   you can redistribute it and/or modify it under the terms of the
+   GNU Lesser General Public License version 2.1 as published by the
+   Free Software Foundation.
+
+   osso-systemui-tklock is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with osso-systemui-powerkeymenu.
+   If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Fixed-extent text for the lock clock. A GtkLabel queues a resize on every
+ * text change, which relayouts the whole lock window each minute. Here the
+ * size is reserved up front from sample strings and digits are laid out in
+ * cells as wide as the widest digit, so the time can change without the
+ * extents ever changing and a tick only repaints the widget itself.
+ *
+ * With the atlas enabled, the text is split into tokens: single digits and
+ * runs of anything else (separators, am/pm). Every token seen in reserved or
+ * set text is rasterized once into an A8 strip, which is shared between the
+ * clocks using the same font and alphabet. A tick then only masks the
+ * cached cells with the foreground color, without any Pango shaping.
+ */
+
+#include <gtk/gtk.h>
+#include <systemui.h>
+
+#include <string.h>
+
+#include "tklock-clock.h"
+
+#define TKLOCK_CLOCK_DATA "tklock-clock"
+
+typedef struct
+{
+  gint ref;
+  gchar *key;
+  cairo_surface_t *surface;
+  GHashTable *cells;
+  gint height;
+} tklock_clock_atlas;
+
+typedef struct
+{
+  GtkWidget *widget;
+  gchar *text;
+  gboolean portrait;
+  /* rotated, for the portrait clock only */
+  PangoContext *context;
+  gboolean digits_measured;
+  gint digit_width[10];
+  gint max_digit_width;
+  gint width;
+  gint height;
+  gboolean use_atlas;
+  GPtrArray *alphabet;
+  GHashTable *token_widths;
+  gint token_height;
+  tklock_clock_atlas *atlas;
+} tklock_clock;
+
+/* the last atlas built, kept so rebuilt views and re-locks do not rasterize */
+static tklock_clock_atlas *atlas_cache = NULL;
+
+static tklock_clock *
+tklock_clock_get(GtkWidget *widget)
+{
+  tklock_clock *clock = g_object_get_data(G_OBJECT(widget), TKLOCK_CLOCK_DATA);
+
+  g_assert(clock != NULL);
+
+  return clock;
+}
+
+static void
+tklock_clock_measure_digits(tklock_clock *clock)
+{
+  PangoLayout *layout;
+  int i;
+
+  if (clock->digits_measured)
+    return;
+
+  layout = gtk_widget_create_pango_layout(clock->widget, NULL);
+  clock->max_digit_width = 0;
+
+  for (i = 0; i < 10; i++)
+  {
+    char digit[2] = {'0' + i, 0};
+    gint w;
+
+    pango_layout_set_text(layout, digit, -1);
+    pango_layout_get_size(layout, &w, NULL);
+    clock->digit_width[i] = w;
+
+    if (w > clock->max_digit_width)
+      clock->max_digit_width = w;
+  }
+
+  g_object_unref(layout);
+  clock->digits_measured = TRUE;
+}
+
+/*
+ * The matrix goes on a context of our own, the one from
+ * gtk_widget_get_pango_context() is what GTK lays out everything else of the
+ * widget with
+ */
+static PangoLayout *
+tklock_clock_create_rotated_layout(tklock_clock *clock, const char *text)
+{
+  PangoLayout *layout;
+
+  if (!clock->context)
+  {
+    PangoMatrix matrix = PANGO_MATRIX_INIT;
+
+    clock->context = gtk_widget_create_pango_context(clock->widget);
+    pango_matrix_rotate(&matrix, 270.0);
+    pango_context_set_matrix(clock->context, &matrix);
+  }
+
+  layout = pango_layout_new(clock->context);
+  pango_layout_set_text(layout, text, -1);
+
+  return layout;
+}
+
+/* every digit is padded to the widest one, so "11:11" is as wide as "00:00" */
+static PangoLayout *
+tklock_clock_create_layout(tklock_clock *clock, const char *text)
+{
+  PangoLayout *layout;
+  PangoAttrList *attrs;
+  const char *p;
+
+  tklock_clock_measure_digits(clock);
+
+  if (clock->portrait)
+    layout = tklock_clock_create_rotated_layout(clock, text);
+  else
+    layout = gtk_widget_create_pango_layout(clock->widget, text);
+
+  attrs = pango_attr_list_new();
+
+  for (p = text; *p; p++)
+  {
+    if (*p >= '0' && *p <= '9')
+    {
+      gint spacing = clock->max_digit_width - clock->digit_width[*p - '0'];
+
+      if (spacing)
+      {
+        PangoAttribute *attr = pango_attr_letter_spacing_new(spacing);
+
+        attr->start_index = p - text;
+        attr->end_index = attr->start_index + 1;
+        pango_attr_list_insert(attrs, attr);
+      }
+    }
+  }
+
+  pango_layout_set_attributes(layout, attrs);
+  pango_attr_list_unref(attrs);
+
+  return layout;
+}
+
+/* returns the length of the token at text, digits are tokens on their own */
+static gsize
+tklock_clock_token_len(const char *text)
+{
+  const char *p = text;
+
+  if (g_ascii_isdigit(*p))
+    return 1;
+
+  while (*p && !g_ascii_isdigit(*p))
+    p++;
+
+  return p - text;
+}
+
+static void
+tklock_clock_atlas_unref(tklock_clock_atlas *atlas)
+{
+  if (!atlas || --atlas->ref)
+    return;
+
+  if (atlas_cache == atlas)
+    atlas_cache = NULL;
+
+  cairo_surface_destroy(atlas->surface);
+  g_hash_table_destroy(atlas->cells);
+  g_free(atlas->key);
+  g_slice_free(tklock_clock_atlas, atlas);
+}
+
+static void
+tklock_clock_drop_atlas(tklock_clock *clock)
+{
+  tklock_clock_atlas_unref(clock->atlas);
+  clock->atlas = NULL;
+}
+
+static PangoLayout *
+tklock_clock_atlas_layout(tklock_clock *clock, cairo_t *cr)
+{
+  PangoLayout *layout = pango_cairo_create_layout(cr);
+  const cairo_font_options_t *options =
+      gdk_screen_get_font_options(gtk_widget_get_screen(clock->widget));
+
+  pango_layout_set_font_description(layout, clock->widget->style->font_desc);
+
+  if (options)
+  {
+    pango_cairo_context_set_font_options(pango_layout_get_context(layout),
+                                         options);
+    pango_layout_context_changed(layout);
+  }
+
+  return layout;
+}
+
+static gchar *
+tklock_clock_atlas_key(tklock_clock *clock)
+{
+  gchar *font = pango_font_description_to_string(
+        clock->widget->style->font_desc);
+  GString *key = g_string_new(font);
+  guint i;
+
+  for (i = 0; i < clock->alphabet->len; i++)
+  {
+    g_string_append_c(key, '\n');
+    g_string_append(key, g_ptr_array_index(clock->alphabet, i));
+  }
+
+  g_free(font);
+
+  return g_string_free(key, FALSE);
+}
+
+static void
+tklock_clock_build_atlas(tklock_clock *clock)
+{
+  tklock_clock_atlas *atlas;
+  cairo_surface_t *surface;
+  PangoLayout *layout;
+  PangoRectangle logical;
+  GdkRectangle *cells;
+  GdkRectangle *cell;
+  gchar *key;
+  cairo_t *cr;
+  gint width = 0;
+  guint i;
+
+  key = tklock_clock_atlas_key(clock);
+
+  if (atlas_cache && !strcmp(atlas_cache->key, key))
+  {
+    g_free(key);
+    tklock_clock_drop_atlas(clock);
+    clock->atlas = atlas_cache;
+    clock->atlas->ref++;
+    return;
+  }
+
+  SYSTEMUI_DEBUG("building clock atlas for %u tokens", clock->alphabet->len);
+
+  /* measure the cells first, the strip is a single row */
+  surface = cairo_image_surface_create(CAIRO_FORMAT_A8, 1, 1);
+  cr = cairo_create(surface);
+  layout = tklock_clock_atlas_layout(clock, cr);
+  cells = g_new0(GdkRectangle, clock->alphabet->len);
+
+  for (i = 0; i < clock->alphabet->len; i++)
+  {
+    pango_layout_set_text(layout, g_ptr_array_index(clock->alphabet, i), -1);
+    pango_layout_get_pixel_extents(layout, NULL, &logical);
+    cells[i].x = width;
+    cells[i].width = logical.width;
+    cells[i].height = logical.height;
+    width += logical.width;
+  }
+
+  g_object_unref(layout);
+  cairo_destroy(cr);
+  cairo_surface_destroy(surface);
+
+  atlas = g_slice_new0(tklock_clock_atlas);
+  atlas->ref = 1;
+  atlas->key = key;
+  atlas->cells = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                       g_free);
+
+  for (i = 0; i < clock->alphabet->len; i++)
+    atlas->height = MAX(atlas->height, cells[i].height);
+
+  atlas->surface = cairo_image_surface_create(CAIRO_FORMAT_A8, MAX(width, 1),
+                                              MAX(atlas->height, 1));
+  cr = cairo_create(atlas->surface);
+  layout = tklock_clock_atlas_layout(clock, cr);
+  cairo_set_source_rgba(cr, 0.0, 0.0, 0.0, 1.0);
+
+  for (i = 0; i < clock->alphabet->len; i++)
+  {
+    const char *token = g_ptr_array_index(clock->alphabet, i);
+
+    pango_layout_set_text(layout, token, -1);
+    pango_layout_get_pixel_extents(layout, NULL, &logical);
+    cairo_move_to(cr, cells[i].x - logical.x, -logical.y);
+    pango_cairo_show_layout(cr, layout);
+    cell = g_new(GdkRectangle, 1);
+    *cell = cells[i];
+    g_hash_table_insert(atlas->cells, g_strdup(token), cell);
+  }
+
+  g_object_unref(layout);
+  cairo_destroy(cr);
+  g_free(cells);
+
+  tklock_clock_drop_atlas(clock);
+  clock->atlas = atlas;
+
+  /* the cache keeps its own reference */
+  tklock_clock_atlas_unref(atlas_cache);
+  atlas_cache = atlas;
+  atlas->ref++;
+}
+
+/* width of a token in pixels, cached, so ticks do not need Pango */
+static gint
+tklock_clock_token_width(tklock_clock *clock, const char *token)
+{
+  gpointer width;
+
+  if (!g_hash_table_lookup_extended(clock->token_widths, token, NULL, &width))
+  {
+    PangoLayout *layout = gtk_widget_create_pango_layout(clock->widget, token);
+    PangoRectangle logical;
+
+    pango_layout_get_pixel_extents(layout, NULL, &logical);
+    g_object_unref(layout);
+
+    width = GINT_TO_POINTER(logical.width);
+    g_hash_table_insert(clock->token_widths, g_strdup(token), width);
+    g_ptr_array_add(clock->alphabet, g_strdup(token));
+    clock->token_height = MAX(clock->token_height, logical.height);
+
+    /* a new token, the atlas has to be rebuilt before the next paint */
+    tklock_clock_drop_atlas(clock);
+  }
+
+  return GPOINTER_TO_INT(width);
+}
+
+static gint
+tklock_clock_atlas_digit_width(tklock_clock *clock)
+{
+  gint max_digit = 0;
+  int i;
+
+  for (i = 0; i < 10; i++)
+  {
+    char digit[2] = {'0' + i, 0};
+
+    max_digit = MAX(max_digit, tklock_clock_token_width(clock, digit));
+  }
+
+  return max_digit;
+}
+
+static void
+tklock_clock_atlas_text_size(tklock_clock *clock, const char *text,
+                             gint *width, gint *height)
+{
+  gint max_digit = tklock_clock_atlas_digit_width(clock);
+  const char *p = text;
+
+  *width = 0;
+
+  while (*p)
+  {
+    gsize len = tklock_clock_token_len(p);
+
+    if (g_ascii_isdigit(*p))
+      *width += max_digit;
+    else
+    {
+      gchar *token = g_strndup(p, len);
+
+      *width += tklock_clock_token_width(clock, token);
+      g_free(token);
+    }
+
+    p += len;
+  }
+
+  *height = clock->token_height;
+}
+
+static void
+tklock_clock_text_size(tklock_clock *clock, const char *text, gint *width,
+                       gint *height)
+{
+  PangoLayout *layout;
+  PangoRectangle logical;
+
+  if (clock->use_atlas)
+  {
+    tklock_clock_atlas_text_size(clock, text, width, height);
+    return;
+  }
+
+  layout = tklock_clock_create_layout(clock, text);
+  pango_layout_get_pixel_extents(layout, NULL, &logical);
+  g_object_unref(layout);
+
+  *width = logical.width;
+  *height = logical.height;
+}
+
+/* returns TRUE if the reserved extents had to grow */
+static gboolean
+tklock_clock_fit(tklock_clock *clock, const char *text)
+{
+  gboolean grown = FALSE;
+  gint width, height;
+
+  tklock_clock_text_size(clock, text, &width, &height);
+
+  if (width > clock->width)
+  {
+    clock->width = width;
+    grown = TRUE;
+  }
+
+  if (height > clock->height)
+  {
+    clock->height = height;
+    grown = TRUE;
+  }
+
+  if (grown)
+  {
+    if (clock->portrait)
+      gtk_widget_set_size_request(clock->widget, clock->height, clock->width);
+    else
+      gtk_widget_set_size_request(clock->widget, clock->width, clock->height);
+  }
+
+  return grown;
+}
+
+static void
+tklock_clock_draw_atlas(tklock_clock *clock, GdkRectangle *area)
+{
+  GtkWidget *widget = clock->widget;
+  gint max_digit = tklock_clock_atlas_digit_width(clock);
+  gint width, height;
+  gint x = 0;
+  const char *p;
+  cairo_t *cr;
+
+  tklock_clock_atlas_text_size(clock, clock->text, &width, &height);
+
+  if (!clock->atlas)
+    tklock_clock_build_atlas(clock);
+
+  cr = gdk_cairo_create(widget->window);
+  gdk_cairo_rectangle(cr, area);
+  cairo_clip(cr);
+  gdk_cairo_set_source_color(cr,
+                             &widget->style->fg[GTK_WIDGET_STATE(widget)]);
+
+  if (clock->portrait)
+  {
+    /* top to bottom, like a label rotated by 270 degrees */
+    cairo_translate(cr, (widget->allocation.width + height) / 2,
+                    (widget->allocation.height - width) / 2);
+    cairo_rotate(cr, G_PI / 2);
+  }
+  else
+  {
+    cairo_translate(cr, (widget->allocation.width - width) / 2,
+                    (widget->allocation.height - height) / 2);
+  }
+
+  for (p = clock->text; *p; )
+  {
+    gsize len = tklock_clock_token_len(p);
+    gchar *token = g_strndup(p, len);
+    GdkRectangle *cell = g_hash_table_lookup(clock->atlas->cells, token);
+    gint advance = g_ascii_isdigit(*p) ?
+          max_digit : tklock_clock_token_width(clock, token);
+
+    if (cell)
+    {
+      gint cx = x + (advance - cell->width) / 2;
+
+      cairo_save(cr);
+      cairo_rectangle(cr, cx, 0, cell->width, cell->height);
+      cairo_clip(cr);
+      cairo_mask_surface(cr, clock->atlas->surface, cx - cell->x, 0);
+      cairo_restore(cr);
+    }
+
+    g_free(token);
+    x += advance;
+    p += len;
+  }
+
+  cairo_destroy(cr);
+}
+
+static gboolean
+tklock_clock_expose_cb(GtkWidget *widget, GdkEventExpose *event,
+                       tklock_clock *clock)
+{
+  PangoLayout *layout;
+  PangoRectangle logical;
+  gint w, h;
+
+  if (!clock->text)
+    return TRUE;
+
+  if (clock->use_atlas)
+  {
+    tklock_clock_draw_atlas(clock, &event->area);
+    return TRUE;
+  }
+
+  layout = tklock_clock_create_layout(clock, clock->text);
+  pango_layout_get_pixel_extents(layout, NULL, &logical);
+
+  if (clock->portrait)
+  {
+    w = logical.height;
+    h = logical.width;
+  }
+  else
+  {
+    w = logical.width;
+    h = logical.height;
+  }
+
+  gdk_gc_set_clip_rectangle(widget->style->fg_gc[GTK_WIDGET_STATE(widget)],
+                            &event->area);
+  gdk_draw_layout(widget->window,
+                  widget->style->fg_gc[GTK_WIDGET_STATE(widget)],
+                  (widget->allocation.width - w) / 2,
+                  (widget->allocation.height - h) / 2, layout);
+  gdk_gc_set_clip_rectangle(widget->style->fg_gc[GTK_WIDGET_STATE(widget)],
+                            NULL);
+
+  g_object_unref(layout);
+
+  return TRUE;
+}
+
+static void
+tklock_clock_realize_cb(GtkWidget *widget, tklock_clock *clock)
+{
+  /* let the lock background show through */
+  gdk_window_set_back_pixmap(widget->window, NULL, TRUE);
+}
+
+static void
+tklock_clock_style_set_cb(GtkWidget *widget, GtkStyle *previous_style,
+                          tklock_clock *clock)
+{
+  /* the font might have changed, text that doesn't fit grows the extents */
+  clock->digits_measured = FALSE;
+  g_hash_table_remove_all(clock->token_widths);
+  g_ptr_array_set_size(clock->alphabet, 0);
+  clock->token_height = 0;
+  tklock_clock_drop_atlas(clock);
+
+  if (clock->context)
+  {
+    g_object_unref(clock->context);
+    clock->context = NULL;
+  }
+
+  if (clock->text)
+    tklock_clock_fit(clock, clock->text);
+}
+
+static void
+tklock_clock_free(gpointer data)
+{
+  tklock_clock *clock = data;
+
+  tklock_clock_drop_atlas(clock);
+
+  if (clock->context)
+    g_object_unref(clock->context);
+
+  g_hash_table_destroy(clock->token_widths);
+  g_ptr_array_free(clock->alphabet, TRUE);
+  g_free(clock->text);
+  g_slice_free(tklock_clock, clock);
+}
+
+GtkWidget *
+tklock_clock_new(gboolean portrait)
+{
+  tklock_clock *clock = g_slice_new0(tklock_clock);
+
+  clock->widget = gtk_drawing_area_new();
+  clock->portrait = portrait;
+  clock->alphabet = g_ptr_array_new_with_free_func(g_free);
+  clock->token_widths = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                              NULL);
+
+  g_signal_connect(clock->widget, "realize",
+                   G_CALLBACK(tklock_clock_realize_cb), clock);
+  g_signal_connect(clock->widget, "style-set",
+                   G_CALLBACK(tklock_clock_style_set_cb), clock);
+  g_signal_connect(clock->widget, "expose-event",
+                   G_CALLBACK(tklock_clock_expose_cb), clock);
+
+  g_object_set_data_full(G_OBJECT(clock->widget), TKLOCK_CLOCK_DATA, clock,
+                         tklock_clock_free);
+
+  return clock->widget;
+}
+
+/* draw from a shared glyph atlas, call before any text is reserved or set */
+void
+tklock_clock_set_use_atlas(GtkWidget *widget, gboolean use_atlas)
+{
+  tklock_clock *clock = tklock_clock_get(widget);
+
+  g_assert(clock->text == NULL && clock->width == 0);
+
+  clock->use_atlas = use_atlas;
+}
+
+/* grow the extents so text fits, call after the font is set */
+void
+tklock_clock_reserve(GtkWidget *widget, const char *text)
+{
+  tklock_clock_fit(tklock_clock_get(widget), text);
+}
+
+/* returns TRUE if the text changed */
+gboolean
+tklock_clock_set_text(GtkWidget *widget, const char *text)
+{
+  tklock_clock *clock = tklock_clock_get(widget);
+
+  if (!g_strcmp0(clock->text, text))
+    return FALSE;
+
+  g_free(clock->text);
+  clock->text = g_strdup(text);
+
+  /* only relayout if the reserved extents were too small */
+  if (tklock_clock_fit(clock, text))
+    SYSTEMUI_DEBUG("'%s' didn't fit, clock extents grown", text);
+
+  gtk_widget_queue_draw(widget);
+
+  return TRUE;
+}
+
+const char *
+tklock_clock_get_text(GtkWidget *widget)
+{
+  return tklock_clock_get(widget)->text;
+}
@@ -0,0 +1,34 @@
+/**
+   @file tklock-clock.h
+
+   @brief Maemo systemui tklock plugin fixed-extent lock clock
+
+   Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+
+   This file is part of osso-systemui-tklock.
+
+   osso-systemui-tklock is free software;
+   you can redistribute it and/or modify it under the terms of the
+   GNU Lesser General Public License version 2.1 as published by the
+   Free Software Foundation.
+
+   osso-systemui-tklock is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with osso-systemui-powerkeymenu.
+   If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __TKLOCK_CLOCK_H__
+#define __TKLOCK_CLOCK_H__
+
+GtkWidget *tklock_clock_new(gboolean portrait);
+void tklock_clock_set_use_atlas(GtkWidget *clock, gboolean use_atlas);
+void tklock_clock_reserve(GtkWidget *clock, const char *text);
+gboolean tklock_clock_set_text(GtkWidget *clock, const char *text);
+const char *tklock_clock_get_text(GtkWidget *clock);
+
+#endif /* __TKLOCK_CLOCK_H__ */
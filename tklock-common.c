@@ -0,0 +1,105 @@
+/**
+   @file tklock-common.c
+
+   @brief Maemo systemui tklock plugin code shared with the visual lock module
+
+   Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+
+   This file is part of osso-systemui-tklock.
+
+   osso-systemui-tklock is free software;
+   you can redistribute it and/or modify it under the terms of the
+   GNU Lesser General Public License version 2.1 as published by the
+   Free Software Foundation.
+
+   osso-systemui-tklock is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with osso-systemui-powerkeymenu.
+   If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Event icon names and clock formatting, needed by both the low power mode
+ * UI and the visual lock. Built into the plugin and into the visual module,
+ * neither exports anything from here.
+ */
+
+#include <gtk/gtk.h>
+#include <gconf/gconf-client.h>
+
+#include <string.h>
+#include <libintl.h>
+#include <clockd/libtime.h>
+
+#include "tklock-common.h"
+
+const char *
+tklock_get_icon_name(guint index)
+{
+  const char *icon_names[]={
+    "tasklaunch_sms_chat",
+    "tasklaunch_authorization_response",
+    "general_chatroom_invitation",
+    "general_application_call",
+    "general_email",
+    "tasklaunch_voice_mail",
+  };
+
+  if (index < G_N_ELEMENTS(icon_names))
+    return icon_names[index];
+  else
+    return NULL;
+}
+
+gboolean
+tklock_time_format_is_24h()
+{
+  GConfClient *gc = gconf_client_get_default();
+  gboolean rv;
+
+  g_assert(gc);
+
+  rv = gconf_client_get_bool(gc, "/apps/clock/time-format", FALSE);
+  g_object_unref(gc);
+
+  return rv;
+}
+
+void
+tklock_format_time(struct tm *tm, gboolean is_24h, char *buf, size_t len)
+{
+  const char *msgid;
+
+  if (is_24h)
+    msgid = "wdgt_va_24h_time";
+  else if (tm->tm_hour > 11)
+    msgid = "wdgt_va_12h_time_pm";
+  else
+    msgid = "wdgt_va_12h_time_am";
+
+  time_format_time(tm, dgettext("hildon-libs", msgid), buf, len - 1);
+}
+
+void
+tklock_format_date(struct tm *tm, char *buf, size_t len)
+{
+  time_format_time(tm, dgettext("hildon-libs", "wdgt_va_date_long"), buf,
+                   len - 1);
+}
+
+void
+tklock_format_current_time(char *buf, size_t len)
+{
+  struct tm tm;
+
+  time_get_synced();
+
+  if (time_get_local(&tm) != 0)
+    memset(&tm, 0, sizeof(tm));
+
+  tklock_format_time(&tm, tklock_time_format_is_24h(), buf, len);
+}
@@ -0,0 +1,36 @@
+/**
+   @file tklock-common.h
+
+   @brief Maemo systemui tklock plugin code shared with the visual lock module
+
+   Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+
+   This file is part of osso-systemui-tklock.
+
+   osso-systemui-tklock is free software;
+   you can redistribute it and/or modify it under the terms of the
+   GNU Lesser General Public License version 2.1 as published by the
+   Free Software Foundation.
+
+   osso-systemui-tklock is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with osso-systemui-powerkeymenu.
+   If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __TKLOCK_COMMON_H__
+#define __TKLOCK_COMMON_H__
+
+#include <time.h>
+
+const char *tklock_get_icon_name(guint index);
+gboolean tklock_time_format_is_24h();
+void tklock_format_time(struct tm *tm, gboolean is_24h, char *buf, size_t len);
+void tklock_format_date(struct tm *tm, char *buf, size_t len);
+void tklock_format_current_time(char *buf, size_t len);
+
+#endif /* __TKLOCK_COMMON_H__ */
@@ -0,0 +1,434 @@
+/**
+   @file tklock-display.c
+
+   @brief Maemo systemui tklock plugin MCE display state tracking
+
+   Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+
+   This file is part of osso-systemui-tklock.
+
+   osso-systemui-tklock is free software;
+   you can redistribute it and/or modify it under the terms of the
+   GNU Lesser General Public License version 2.1 as published by the
+   Free Software Foundation.
+
+   osso-systemui-tklock is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with osso-systemui-powerkeymenu.
+   If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * MCE display state tracking. The state is kept in an atomic so lock
+ * teardown decisions can read it at any time, no matter how busy the main
+ * loop is. Signals are received by a dedicated thread on a private system bus
+ * connection and forwarded to the main loop by a high priority idle. If that
+ * connection is lost, the thread hands over to a filter on the shared
+ * connection.
+ *
+ * The initial state is queried asynchronously at startup. Nothing orders the
+ * reply against the signals, so the reply is only applied if the state is
+ * still unknown: a reply that was overtaken by a display_status_ind signal
+ * is dropped.
+ */
+
+#include <gtk/gtk.h>
+#include <dbus/dbus.h>
+#include <systemui.h>
+#include <mce/dbus-names.h>
+#include <mce/mode-names.h>
+
+#include <string.h>
+
+#include "tklock-display.h"
+
+#define DBUS_MCE_MATCH_RULE \
+  "type='signal',path='/com/nokia/mce/signal'," \
+  "interface='com.nokia.mce.signal'," \
+  "member='display_status_ind'"
+
+/* how often the watcher thread checks if it has to exit, in ms */
+#define WATCHER_POLL_TIMEOUT 500
+
+static gint display_state = TKLOCK_DISPLAY_UNKNOWN;
+static gint watcher_quit = 0;
+static GThread *watcher_thread = NULL;
+static DBusConnection *watcher_conn = NULL;
+static DBusConnection *shared_conn = NULL;
+/* the connection systemui gave us, for the fallback */
+static DBusConnection *main_conn = NULL;
+static DBusPendingCall *status_query = NULL;
+static tklock_display_cb display_cb = NULL;
+
+/* main loop sources queued by the watcher thread */
+G_LOCK_DEFINE_STATIC(watcher_sources);
+static guint dispatch_id = 0;
+static guint fallback_id = 0;
+
+static tklock_display_state
+tklock_display_state_from_string(const char *status)
+{
+  SYSTEMUI_DEBUG("status '%s'", status);
+
+  if (!strcmp(status, MCE_DISPLAY_OFF_STRING))
+    return TKLOCK_DISPLAY_OFF;
+
+  return TKLOCK_DISPLAY_ON;
+}
+
+static tklock_display_state
+tklock_display_parse_signal(DBusMessage *message)
+{
+  const char *status;
+
+  if (!dbus_message_is_signal(message, MCE_SIGNAL_IF, MCE_DISPLAY_SIG))
+    return TKLOCK_DISPLAY_UNKNOWN;
+
+  if (!dbus_message_get_args(message, NULL,
+                             DBUS_TYPE_STRING, &status,
+                             DBUS_TYPE_INVALID))
+  {
+    return TKLOCK_DISPLAY_UNKNOWN;
+  }
+
+  return tklock_display_state_from_string(status);
+}
+
+/* reports the latest state, signals since the last dispatch are coalesced */
+static gboolean
+tklock_display_dispatch_cb(gpointer user_data)
+{
+  SYSTEMUI_DEBUG_FN;
+
+  G_LOCK(watcher_sources);
+  dispatch_id = 0;
+  G_UNLOCK(watcher_sources);
+
+  if (display_cb)
+    display_cb(g_atomic_int_get(&display_state));
+
+  return FALSE;
+}
+
+static DBusHandlerResult
+tklock_display_thread_filter(DBusConnection *connection, DBusMessage *message,
+                             void *data)
+{
+  tklock_display_state state = tklock_display_parse_signal(message);
+
+  if (state != TKLOCK_DISPLAY_UNKNOWN)
+  {
+    g_atomic_int_set(&display_state, state);
+    G_LOCK(watcher_sources);
+
+    if (!dispatch_id)
+    {
+      dispatch_id = g_idle_add_full(G_PRIORITY_HIGH,
+                                    tklock_display_dispatch_cb, NULL, NULL);
+    }
+
+    G_UNLOCK(watcher_sources);
+  }
+
+  return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+static DBusHandlerResult
+tklock_display_shared_filter(DBusConnection *connection, DBusMessage *message,
+                             void *data)
+{
+  tklock_display_state state = tklock_display_parse_signal(message);
+
+  if (state != TKLOCK_DISPLAY_UNKNOWN)
+  {
+    g_atomic_int_set(&display_state, state);
+
+    if (display_cb)
+      display_cb(state);
+  }
+
+  return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+static void
+tklock_display_query_notify(DBusPendingCall *pending, void *user_data)
+{
+  DBusMessage *reply;
+  DBusError error;
+  const char *status;
+
+  SYSTEMUI_DEBUG_FN;
+
+  g_assert(pending == status_query);
+
+  reply = dbus_pending_call_steal_reply(pending);
+  dbus_pending_call_unref(status_query);
+  status_query = NULL;
+
+  if (!reply)
+    return;
+
+  dbus_error_init(&error);
+
+  if (dbus_set_error_from_message(&error, reply) ||
+      !dbus_message_get_args(reply, &error,
+                             DBUS_TYPE_STRING, &status,
+                             DBUS_TYPE_INVALID))
+  {
+    SYSTEMUI_WARNING("failed to get display status: %s", error.message);
+    dbus_error_free(&error);
+  }
+  else
+  {
+    tklock_display_state state = tklock_display_state_from_string(status);
+
+    if (g_atomic_int_compare_and_exchange(&display_state,
+                                          TKLOCK_DISPLAY_UNKNOWN, state))
+    {
+      if (display_cb)
+        display_cb(state);
+    }
+    else
+      SYSTEMUI_DEBUG("display status reply overtaken by a signal, ignored");
+  }
+
+  dbus_message_unref(reply);
+}
+
+static void
+tklock_display_query(DBusConnection *conn)
+{
+  DBusMessage *mcall;
+
+  SYSTEMUI_DEBUG_FN;
+
+  mcall = dbus_message_new_method_call(MCE_SERVICE, MCE_REQUEST_PATH,
+                                       MCE_REQUEST_IF,
+                                       MCE_DISPLAY_STATUS_GET);
+
+  if (!mcall)
+    return;
+
+  if (!dbus_connection_send_with_reply(conn, mcall, &status_query, -1) ||
+      !status_query)
+  {
+    SYSTEMUI_WARNING("failed to query display status");
+  }
+  else if (!dbus_pending_call_set_notify(status_query,
+                                         tklock_display_query_notify,
+                                         NULL, NULL))
+  {
+    dbus_pending_call_cancel(status_query);
+    dbus_pending_call_unref(status_query);
+    status_query = NULL;
+  }
+
+  dbus_message_unref(mcall);
+}
+
+static gboolean tklock_display_fallback_cb(gpointer user_data);
+
+static gpointer
+tklock_display_thread(gpointer user_data)
+{
+  DBusConnection *conn = user_data;
+
+  while (!g_atomic_int_get(&watcher_quit))
+  {
+    if (!dbus_connection_read_write_dispatch(conn, WATCHER_POLL_TIMEOUT))
+    {
+      /* disconnected, let the main loop take over */
+      G_LOCK(watcher_sources);
+      fallback_id = g_idle_add_full(G_PRIORITY_HIGH,
+                                    tklock_display_fallback_cb, NULL, NULL);
+      G_UNLOCK(watcher_sources);
+      break;
+    }
+  }
+
+  return NULL;
+}
+
+static gboolean
+tklock_display_shared_start(DBusConnection *conn)
+{
+  if (!dbus_connection_add_filter(conn, tklock_display_shared_filter,
+                                  NULL, NULL))
+  {
+    SYSTEMUI_ERROR("failed to install display status filter");
+    return FALSE;
+  }
+
+  dbus_bus_add_match(conn, DBUS_MCE_MATCH_RULE, NULL);
+  shared_conn = conn;
+
+  return TRUE;
+}
+
+static gboolean
+tklock_display_thread_start()
+{
+  DBusError error;
+
+  dbus_threads_init_default();
+  dbus_error_init(&error);
+
+  watcher_conn = dbus_bus_get_private(DBUS_BUS_SYSTEM, &error);
+
+  if (!watcher_conn)
+  {
+    SYSTEMUI_WARNING("failed to open private system bus connection: %s",
+                     error.message);
+    dbus_error_free(&error);
+    return FALSE;
+  }
+
+  dbus_connection_set_exit_on_disconnect(watcher_conn, FALSE);
+
+  if (!dbus_connection_add_filter(watcher_conn, tklock_display_thread_filter,
+                                  NULL, NULL))
+  {
+    SYSTEMUI_WARNING("failed to install display watcher filter");
+    goto err_close;
+  }
+
+  dbus_bus_add_match(watcher_conn, DBUS_MCE_MATCH_RULE, NULL);
+  g_atomic_int_set(&watcher_quit, 0);
+
+  watcher_thread = g_thread_try_new("tklock-display", tklock_display_thread,
+                                    watcher_conn, NULL);
+
+  if (watcher_thread)
+    return TRUE;
+
+  SYSTEMUI_WARNING("failed to start display watcher thread");
+  dbus_connection_remove_filter(watcher_conn, tklock_display_thread_filter,
+                                NULL);
+
+err_close:
+  dbus_connection_close(watcher_conn);
+  dbus_connection_unref(watcher_conn);
+  watcher_conn = NULL;
+
+  return FALSE;
+}
+
+static void
+tklock_display_thread_stop()
+{
+  g_atomic_int_set(&watcher_quit, 1);
+  g_thread_join(watcher_thread);
+  watcher_thread = NULL;
+
+  /* the thread is gone, nothing can queue more sources */
+  if (dispatch_id)
+  {
+    g_source_remove(dispatch_id);
+    dispatch_id = 0;
+  }
+
+  if (fallback_id)
+  {
+    g_source_remove(fallback_id);
+    fallback_id = 0;
+  }
+
+  dbus_connection_remove_filter(watcher_conn, tklock_display_thread_filter,
+                                NULL);
+  dbus_connection_close(watcher_conn);
+  dbus_connection_unref(watcher_conn);
+  watcher_conn = NULL;
+}
+
+static gboolean
+tklock_display_fallback_cb(gpointer user_data)
+{
+  gboolean pending;
+
+  SYSTEMUI_WARNING("display watcher lost its system bus connection, "
+                   "watching the display from the main loop");
+
+  /* the thread has left its loop, it won't dispatch anything else */
+  G_LOCK(watcher_sources);
+  fallback_id = 0;
+  pending = dispatch_id != 0;
+  G_UNLOCK(watcher_sources);
+
+  tklock_display_thread_stop();
+  tklock_display_shared_start(main_conn);
+
+  /* deliver what the thread got before it went away */
+  if (pending && display_cb)
+    display_cb(g_atomic_int_get(&display_state));
+
+  return FALSE;
+}
+
+gboolean
+tklock_display_watcher_start(DBusConnection *conn, tklock_display_cb cb)
+{
+  SYSTEMUI_DEBUG_FN;
+
+  g_assert(conn != NULL);
+  g_assert(watcher_thread == NULL && shared_conn == NULL);
+
+  display_cb = cb;
+  main_conn = conn;
+
+  /* no thread, track the display on the main loop like we always did */
+  if (!tklock_display_thread_start() && !tklock_display_shared_start(conn))
+  {
+    display_cb = NULL;
+    main_conn = NULL;
+    return FALSE;
+  }
+
+  /* signals may still overtake the reply, see the CAS in the notify */
+  tklock_display_query(conn);
+
+  return TRUE;
+}
+
+void
+tklock_display_watcher_stop()
+{
+  SYSTEMUI_DEBUG_FN;
+
+  display_cb = NULL;
+
+  if (status_query)
+  {
+    dbus_pending_call_cancel(status_query);
+    dbus_pending_call_unref(status_query);
+    status_query = NULL;
+  }
+
+  if (watcher_thread)
+    tklock_display_thread_stop();
+
+  if (shared_conn)
+  {
+    dbus_bus_remove_match(shared_conn, DBUS_MCE_MATCH_RULE, NULL);
+    dbus_connection_remove_filter(shared_conn, tklock_display_shared_filter,
+                                  NULL);
+    shared_conn = NULL;
+  }
+
+  main_conn = NULL;
+}
+
+tklock_display_state
+tklock_display_get_state()
+{
+  return g_atomic_int_get(&display_state);
+}
+
+gboolean
+tklock_display_is_off()
+{
+  return tklock_display_get_state() == TKLOCK_DISPLAY_OFF;
+}
@@ -0,0 +1,44 @@
+/**
+   @file tklock-display.h
+
+   @brief Maemo systemui tklock plugin MCE display state tracking
+
+   Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+
+   This file is part of osso-systemui-tklock.
+
+   osso-systemui-tklock is free software;
+   you can redistribute it and/or modify it under the terms of the
+   GNU Lesser General Public License version 2.1 as published by the
+   Free Software Foundation.
+
+   osso-systemui-tklock is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with osso-systemui-powerkeymenu.
+   If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __TKLOCK_DISPLAY_H__
+#define __TKLOCK_DISPLAY_H__
+
+typedef enum
+{
+  TKLOCK_DISPLAY_UNKNOWN,
+  TKLOCK_DISPLAY_ON,
+  TKLOCK_DISPLAY_OFF
+} tklock_display_state;
+
+/* Always called from the main loop */
+typedef void (*tklock_display_cb)(tklock_display_state state);
+
+gboolean tklock_display_watcher_start(DBusConnection *conn,
+                                      tklock_display_cb cb);
+void tklock_display_watcher_stop();
+tklock_display_state tklock_display_get_state();
+gboolean tklock_display_is_off();
+
+#endif /* __TKLOCK_DISPLAY_H__ */
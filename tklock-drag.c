@@ -0,0 +1,202 @@
+/**
+   @file tklock-drag.c
+
+   @brief Maemo systemui tklock plugin slider drag benchmark
+
+   Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+
+   This file is part of osso-systemui-tklock.
+
+   osso-systemui-tklock is free software;
+   you can redistribute it and/or modify it under the terms of the
+   GNU Lesser General Public License version 2.1 as published by the
+   Free Software Foundation.
+
+   osso-systemui-tklock is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with osso-systemui-powerkeymenu.
+   If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Benchmark tool: drags the pointer over the visual tklock slider with XTest,
+ * the same gesture every run, so the slider drag stats the plugin logs on
+ * close are comparable between slider implementations and builds.
+ *
+ * tklock-drag [-n RUNS] [-s STEPS] [-i MS] [-u [-f]] X0,Y0 X1,Y1
+ *
+ * Each run presses at X0,Y0, moves to X1,Y1 in STEPS motion events MS
+ * milliseconds apart, moves back the same way and releases, so the lock stays
+ * up for the next run. -u releases at X1,Y1 instead, to measure an unlock,
+ * and makes it a single run.
+ *
+ * The gesture slider also unlocks when released past its middle at 1 px/ms
+ * or more, the hildon scale doesn't, so such a release would compare two
+ * different gestures. The distance over STEPS * MS has to stay below that
+ * with -u, unless -f says the fling is wanted. A partial drag releases
+ * moving back, which is never a fling.
+ *
+ * Run it on the device or an Xvfb session with the lock shown and
+ * /system/systemui/tklock/drag_stats set, once per
+ * /system/systemui/tklock/gesture_slider setting. tklock-drag.sh does that
+ * under Xvfb, for landscape and fake portrait.
+ */
+
+#include <X11/Xlib.h>
+#include <X11/extensions/XTest.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+#define DRAG_RUNS 10
+#define DRAG_STEPS 40
+#define DRAG_INTERVAL 16
+/* let the lock settle between runs */
+#define DRAG_PAUSE 500
+/* px/ms, TKLOCK_SLIDER_FLING_VELOCITY in tklock-slider.c */
+#define DRAG_FLING_VELOCITY 1.0
+
+static void
+usage(const char *name)
+{
+  fprintf(stderr,
+          "usage: %s [-n RUNS] [-s STEPS] [-i MS] [-u [-f]] X0,Y0 X1,Y1\n",
+          name);
+  exit(1);
+}
+
+static long
+now_us()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+/* returns how long XTest took to take the motion events, in us */
+static long
+drag_move(Display *dpy, int x0, int y0, int x1, int y1, int steps,
+          int interval)
+{
+  long total = 0;
+  int i;
+
+  for (i = 1; i <= steps; i++)
+  {
+    long start = now_us();
+
+    XTestFakeMotionEvent(dpy, -1, x0 + (x1 - x0) * i / steps,
+                         y0 + (y1 - y0) * i / steps, CurrentTime);
+    XSync(dpy, False);
+    total += now_us() - start;
+    usleep(interval * 1000);
+  }
+
+  return total;
+}
+
+int
+main(int argc, char **argv)
+{
+  int runs = DRAG_RUNS;
+  int steps = DRAG_STEPS;
+  int interval = DRAG_INTERVAL;
+  int unlock = 0;
+  int fling = 0;
+  double dist2, time2;
+  int x0, y0, x1, y1;
+  int event, error, major, minor;
+  long inject = 0, start;
+  Display *dpy;
+  int i, opt;
+
+  while ((opt = getopt(argc, argv, "n:s:i:uf")) != -1)
+  {
+    if (opt == 'n')
+      runs = atoi(optarg);
+    else if (opt == 's')
+      steps = atoi(optarg);
+    else if (opt == 'i')
+      interval = atoi(optarg);
+    else if (opt == 'u')
+      unlock = 1;
+    else if (opt == 'f')
+      fling = 1;
+    else
+      usage(argv[0]);
+  }
+
+  if (argc - optind != 2 ||
+      sscanf(argv[optind], "%d,%d", &x0, &y0) != 2 ||
+      sscanf(argv[optind + 1], "%d,%d", &x1, &y1) != 2 ||
+      runs <= 0 || steps <= 0 || interval < 0)
+  {
+    usage(argv[0]);
+  }
+
+  /* squared, so there is no need for libm */
+  dist2 = (double)(x1 - x0) * (x1 - x0) + (double)(y1 - y0) * (y1 - y0);
+  time2 = (double)steps * interval * steps * interval;
+
+  if (unlock && !fling &&
+      dist2 >= DRAG_FLING_VELOCITY * DRAG_FLING_VELOCITY * time2)
+  {
+    fprintf(stderr, "%s: that drag is a fling for the gesture slider, "
+            "raise -s or -i, or pass -f\n", argv[0]);
+    return 1;
+  }
+
+  dpy = XOpenDisplay(NULL);
+
+  if (!dpy)
+  {
+    fprintf(stderr, "%s: can't open display\n", argv[0]);
+    return 1;
+  }
+
+  if (!XTestQueryExtension(dpy, &event, &error, &major, &minor))
+  {
+    fprintf(stderr, "%s: no XTest extension\n", argv[0]);
+    XCloseDisplay(dpy);
+    return 1;
+  }
+
+  start = now_us();
+
+  for (i = 0; i < runs; i++)
+  {
+    XTestFakeMotionEvent(dpy, -1, x0, y0, CurrentTime);
+    XTestFakeButtonEvent(dpy, 1, True, CurrentTime);
+    XSync(dpy, False);
+
+    inject += drag_move(dpy, x0, y0, x1, y1, steps, interval);
+
+    if (!unlock)
+      inject += drag_move(dpy, x1, y1, x0, y0, steps, interval);
+
+    XTestFakeButtonEvent(dpy, 1, False, CurrentTime);
+    XSync(dpy, False);
+
+    if (unlock)
+      break;
+
+    usleep(DRAG_PAUSE * 1000);
+  }
+
+  printf("%d drags, %d motion events each, %d ms apart, %ld ms total, "
+         "avg %ld us per XTest motion\n", unlock ? 1 : runs,
+         unlock ? steps : 2 * steps, interval, (now_us() - start) / 1000,
+         inject / ((unlock ? 1 : 2L * runs) * steps));
+
+  XCloseDisplay(dpy);
+
+  return 0;
+}
@@ -0,0 +1,77 @@
+#!/bin/sh
+#
+# Slider drag benchmark under Xvfb: for landscape (800x480) and fake portrait
+# (480x800) it starts Xvfb and systemui, shows the visual tklock, runs
+# tklock-drag over the slider, a partial drag and an unlock, hides the lock
+# and prints the drag stats the plugin logged for it.
+#
+# tklock-drag.sh [RUNS]
+#
+# Needs Xvfb, systemui with this plugin installed, the system bus, gconftool-2
+# and ./tklock-drag (make tklock-drag). Compare the hildon scale and the
+# gesture slider by running it once with GESTURE_SLIDER=false and once with
+# GESTURE_SLIDER=true.
+#
+# The default coordinates are where the cairo renderer puts the slider thumb,
+# its start, the middle of the trough and its end. For the widget tree layout,
+# or another theme, set LANDSCAPE_DRAG and PORTRAIT_DRAG to
+# "X0,Y0 XMID,YMID X1,Y1".
+
+RUNS=${1:-10}
+XVFB_DISPLAY=${XVFB_DISPLAY:-:42}
+GESTURE_SLIDER=${GESTURE_SLIDER:-true}
+CAIRO_RENDERER=${CAIRO_RENDERER:-true}
+LANDSCAPE_DRAG=${LANDSCAPE_DRAG:-"228,264 400,264 572,264"}
+PORTRAIT_DRAG=${PORTRAIT_DRAG:-"216,228 216,400 216,572"}
+# where SYSTEMUI_NOTICE ends up
+SYSLOG=${SYSLOG:-/var/log/syslog}
+
+KEYS=/system/systemui/tklock
+SYSTEMUI_REQ="--system --print-reply --dest=com.nokia.system_ui \
+  /com/nokia/system_ui/request com.nokia.system_ui.request"
+# systemui calls that back on unlock, nobody listens there
+CALLBACK="string:com.nokia.tklock_drag string:/ \
+  string:com.nokia.tklock_drag string:unlocked"
+TKLOCK_ENABLE_VISUAL=5
+
+set -e
+
+gconftool-2 -s -t bool $KEYS/drag_stats true
+gconftool-2 -s -t bool $KEYS/gesture_slider $GESTURE_SLIDER
+gconftool-2 -s -t bool $KEYS/cairo_renderer $CAIRO_RENDERER
+
+run()
+{
+  size=$1
+  set -- $2
+
+  Xvfb $XVFB_DISPLAY -screen 0 ${size}x16 -nolisten tcp &
+  xvfb=$!
+  sleep 1
+
+  DISPLAY=$XVFB_DISPLAY systemui &
+  systemui=$!
+  sleep 3
+
+  lines=$(wc -l < $SYSLOG)
+
+  dbus-send $SYSTEMUI_REQ.tklock_open $CALLBACK \
+    uint32:$TKLOCK_ENABLE_VISUAL boolean:false boolean:false > /dev/null
+  sleep 1
+
+  echo "$size, $GESTURE_SLIDER gesture slider:"
+  DISPLAY=$XVFB_DISPLAY ./tklock-drag -n $RUNS $1 $2
+  DISPLAY=$XVFB_DISPLAY ./tklock-drag -u $1 $3
+  sleep 1
+
+  # the plugin logs the drag stats when the lock goes away
+  dbus-send $SYSTEMUI_REQ.tklock_close boolean:true > /dev/null
+  sleep 1
+  tail -n +$((lines + 1)) $SYSLOG | grep 'slider' || true
+
+  kill $systemui $xvfb
+  wait $systemui $xvfb 2> /dev/null || true
+}
+
+run 800x480 "$LANDSCAPE_DRAG"
+run 480x800 "$PORTRAIT_DRAG"
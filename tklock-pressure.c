@@ -0,0 +1,205 @@
+/**
+   @file tklock-pressure.c
+
+   @brief Maemo systemui tklock plugin memory pressure watcher
+
+   Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+
+   This file is part of osso-systemui-tklock.
+
+   osso-systemui-tklock is free software;
+   you can redistribute it and/or modify it under the terms of the
+   GNU Lesser General Public License version 2.1 as published by the
+   Free Software Foundation.
+
+   osso-systemui-tklock is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with osso-systemui-powerkeymenu.
+   If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Memory pressure notifications. A PSI trigger is armed on
+ * /proc/pressure/memory, the kernel then wakes us up with POLLPRI every time
+ * tasks were stalled on memory for long enough within the trigger window.
+ *
+ * For testing on kernels without PSI, TKLOCK_PRESSURE_FIFO names a fifo to
+ * watch instead, every write to it counts as one pressure event:
+ *
+ *   mkfifo /tmp/pressure
+ *   TKLOCK_PRESSURE_FIFO=/tmp/pressure systemui &
+ *   echo > /tmp/pressure
+ */
+
+#include <gtk/gtk.h>
+#include <systemui.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "tklock-pressure.h"
+
+#define TKLOCK_PRESSURE_PSI "/proc/pressure/memory"
+#define TKLOCK_PRESSURE_FIFO_ENV "TKLOCK_PRESSURE_FIFO"
+
+/*
+ * 150 ms of partial stall within 2 s. Unprivileged triggers need a window
+ * that is a multiple of 2 s.
+ */
+#define TKLOCK_PRESSURE_TRIGGER "some 150000 2000000"
+
+static int pressure_fd = -1;
+static guint pressure_id = 0;
+static const char *pressure_fifo = NULL;
+static tklock_pressure_cb pressure_cb = NULL;
+
+static gboolean tklock_pressure_fifo_open();
+
+static gboolean
+tklock_pressure_event_cb(GIOChannel *source, GIOCondition condition,
+                         gpointer data)
+{
+  char buf[64];
+
+  SYSTEMUI_DEBUG("condition 0x%x", condition);
+
+  if (condition & G_IO_ERR)
+  {
+    SYSTEMUI_WARNING("memory pressure watch failed, stopping it");
+    close(pressure_fd);
+    pressure_fd = -1;
+    pressure_id = 0;
+
+    return FALSE;
+  }
+
+  if (pressure_fifo)
+  {
+    ssize_t len = read(pressure_fd, buf, sizeof(buf));
+
+    /* the writer went away, re-open so the next one is seen too */
+    if (len <= 0)
+    {
+      if (len < 0 && errno == EAGAIN)
+        return TRUE;
+
+      close(pressure_fd);
+      pressure_fd = -1;
+      pressure_id = 0;
+
+      if (!tklock_pressure_fifo_open())
+        pressure_cb = NULL;
+
+      return FALSE;
+    }
+  }
+
+  if (pressure_cb)
+    pressure_cb();
+
+  return TRUE;
+}
+
+static gboolean
+tklock_pressure_watch(GIOCondition condition)
+{
+  GIOChannel *channel = g_io_channel_unix_new(pressure_fd);
+
+  pressure_id = g_io_add_watch(channel, condition | G_IO_ERR,
+                               tklock_pressure_event_cb, NULL);
+  g_io_channel_unref(channel);
+
+  return pressure_id != 0;
+}
+
+static gboolean
+tklock_pressure_fifo_open()
+{
+  /* non-blocking, so there is no need to wait for a writer */
+  pressure_fd = open(pressure_fifo, O_RDONLY | O_NONBLOCK);
+
+  if (pressure_fd == -1)
+  {
+    SYSTEMUI_WARNING("failed to open %s: %s", pressure_fifo,
+                     strerror(errno));
+    return FALSE;
+  }
+
+  return tklock_pressure_watch(G_IO_IN | G_IO_HUP);
+}
+
+static gboolean
+tklock_pressure_psi_open()
+{
+  pressure_fd = open(TKLOCK_PRESSURE_PSI, O_RDWR | O_NONBLOCK);
+
+  if (pressure_fd == -1)
+  {
+    SYSTEMUI_NOTICE("no PSI support, memory pressure won't be tracked");
+    return FALSE;
+  }
+
+  if (write(pressure_fd, TKLOCK_PRESSURE_TRIGGER,
+            strlen(TKLOCK_PRESSURE_TRIGGER) + 1) < 0)
+  {
+    SYSTEMUI_WARNING("failed to arm PSI trigger: %s", strerror(errno));
+    close(pressure_fd);
+    pressure_fd = -1;
+    return FALSE;
+  }
+
+  return tklock_pressure_watch(G_IO_PRI);
+}
+
+gboolean
+tklock_pressure_watcher_start(tklock_pressure_cb cb)
+{
+  gboolean started;
+
+  SYSTEMUI_DEBUG_FN;
+
+  g_assert(pressure_fd == -1);
+
+  pressure_fifo = g_getenv(TKLOCK_PRESSURE_FIFO_ENV);
+
+  if (pressure_fifo)
+    started = tklock_pressure_fifo_open();
+  else
+    started = tklock_pressure_psi_open();
+
+  if (!started)
+  {
+    tklock_pressure_watcher_stop();
+    return FALSE;
+  }
+
+  pressure_cb = cb;
+
+  return TRUE;
+}
+
+void
+tklock_pressure_watcher_stop()
+{
+  SYSTEMUI_DEBUG_FN;
+
+  pressure_cb = NULL;
+
+  if (pressure_id)
+  {
+    g_source_remove(pressure_id);
+    pressure_id = 0;
+  }
+
+  if (pressure_fd != -1)
+  {
+    close(pressure_fd);
+    pressure_fd = -1;
+  }
+}
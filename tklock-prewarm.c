@@ -0,0 +1,358 @@
+/**
+   @file tklock-prewarm.c
+
+   @brief Maemo systemui tklock plugin lock resources prewarm
+
+   Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+
+   This file is part of osso-systemui-tklock.
+
+   osso-systemui-tklock is free software;
+   you can redistribute it and/or modify it under the terms of the
+   GNU Lesser General Public License version 2.1 as published by the
+   Free Software Foundation.
+
+   osso-systemui-tklock is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with osso-systemui-powerkeymenu.
+   If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Loads what the first lock would otherwise have to load on its own: the
+ * GConf client and the tklock keys, X atoms, the visual lock module, the
+ * lockslider images, the event icons, the clock fonts and the notifications
+ * database. The module, the images and the database block on the disk for
+ * tens of ms each, so a thread does those. The rest has to use GDK or GTK and
+ * runs from a low priority idle on the main loop, a few steps at a time until
+ * the time slice is used up, so other systemui work always goes first. A step
+ * is not interrupted, the slice only bounds how many of them run back to
+ * back. Everything ends up in the caches the locks use anyway, nothing here
+ * is needed for correctness.
+ */
+
+#include <gtk/gtk.h>
+#include <gdk/gdkx.h>
+#include <gconf/gconf-client.h>
+#include <systemui.h>
+
+#include <unistd.h>
+
+#include "visual-tklock.h"
+#include "tklock-common.h"
+#include "tklock-visual.h"
+#include "tklock-prewarm.h"
+
+#define TKLOCK_GCONF_DIR "/system/systemui/tklock"
+#define LOCKSLIDER_PORTRAIT_BACKGROUND \
+  "/etc/hildon/theme/backgrounds/lockslider-portrait.png"
+
+/* how long a single idle callback may keep the main loop, in us */
+#define TKLOCK_PREWARM_SLICE 2000
+/* how often to check if the thread is done, in ms */
+#define TKLOCK_PREWARM_POLL 50
+
+/* a step returns TRUE if it has to be called again, with n + 1 */
+typedef gboolean (*tklock_prewarm_step)(guint n);
+
+static GConfClient *prewarm_gconf = NULL;
+static guint prewarm_id = 0;
+static guint prewarm_step = 0;
+static guint prewarm_n = 0;
+static GThread *prewarm_thread = NULL;
+static gint prewarm_thread_done = 0;
+static gint prewarm_quit = 0;
+static gint prewarm_width = 0;
+static gint prewarm_height = 0;
+
+static void
+tklock_prewarm_blocking()
+{
+  /* the images and the database need it */
+  if (!tklock_visual_load())
+    return;
+
+  if (!g_atomic_int_get(&prewarm_quit))
+    tklock_visual_prewarm_background(FALSE, prewarm_width, prewarm_height);
+
+  if (!g_atomic_int_get(&prewarm_quit) &&
+      !access(LOCKSLIDER_PORTRAIT_BACKGROUND, R_OK))
+  {
+    tklock_visual_prewarm_background(TRUE, prewarm_width, prewarm_height);
+  }
+
+  if (!g_atomic_int_get(&prewarm_quit))
+    tklock_visual_prewarm_db();
+}
+
+static gpointer
+tklock_prewarm_thread(gpointer user_data)
+{
+  tklock_prewarm_blocking();
+  g_atomic_int_set(&prewarm_thread_done, 1);
+
+  return NULL;
+}
+
+static void
+tklock_prewarm_thread_join()
+{
+  if (prewarm_thread)
+  {
+    g_atomic_int_set(&prewarm_quit, 1);
+    g_thread_join(prewarm_thread);
+    prewarm_thread = NULL;
+  }
+}
+
+static gboolean
+tklock_prewarm_gconf(guint n)
+{
+  /* keeps the client alive and the tklock keys in its cache */
+  prewarm_gconf = gconf_client_get_default();
+
+  if (prewarm_gconf)
+  {
+    gconf_client_add_dir(prewarm_gconf, TKLOCK_GCONF_DIR,
+                         GCONF_CLIENT_PRELOAD_ONELEVEL, NULL);
+  }
+
+  return FALSE;
+}
+
+static gboolean
+tklock_prewarm_atoms(guint n)
+{
+  static const char *atoms[] =
+  {
+    "_NET_WM_STATE",
+    "_NET_WM_STATE_FULLSCREEN",
+    "_HILDON_STACKING_LAYER",
+    "_HILDON_WM_ACTION_NO_TRANSITIONS",
+    "_HILDON_PORTRAIT_MODE_SUPPORT",
+    "_HILDON_PORTRAIT_MODE_REQUEST",
+    "_HILDON_DO_NOT_DISTURB"
+  };
+
+  gdk_x11_get_xatom_by_name(atoms[n]);
+
+  return n + 1 < G_N_ELEMENTS(atoms);
+}
+
+static gboolean
+tklock_prewarm_spawn(guint n)
+{
+  GdkScreen *screen = gdk_screen_get_default();
+
+  /* no GDK in the thread */
+  prewarm_width = gdk_screen_get_width(screen);
+  prewarm_height = gdk_screen_get_height(screen);
+  g_atomic_int_set(&prewarm_thread_done, 0);
+  g_atomic_int_set(&prewarm_quit, 0);
+
+  prewarm_thread = g_thread_try_new("tklock-prewarm", tklock_prewarm_thread,
+                                    NULL, NULL);
+
+  /*
+   * Not on the main loop, that is what the thread is for. The first lock
+   * loads the module, the images and the database itself, as it did before
+   * there was a prewarm.
+   */
+  if (!prewarm_thread)
+    SYSTEMUI_WARNING("failed to start prewarm thread, skipping disk steps");
+
+  return FALSE;
+}
+
+static gboolean
+tklock_prewarm_icons(guint n)
+{
+  GdkPixbuf *pixbuf = tklock_visual_get_event_icon(n);
+
+  if (pixbuf)
+    g_object_unref(pixbuf);
+
+  return tklock_get_icon_name(n + 1) != NULL;
+}
+
+static gboolean
+tklock_prewarm_fonts(guint n)
+{
+  /* clock and event counts, the date and the hint use the theme font */
+  static const int sizes[] = {75, 25};
+  PangoContext *context = gdk_pango_context_get();
+  PangoLayout *layout = pango_layout_new(context);
+  PangoFontDescription *font_desc = pango_font_description_new();
+  PangoRectangle logical;
+
+  pango_font_description_set_family(font_desc, "Nokia Sans");
+  pango_font_description_set_absolute_size(font_desc,
+                                           sizes[n] * PANGO_SCALE);
+  pango_layout_set_font_description(layout, font_desc);
+  pango_layout_set_text(layout, "0123456789:", -1);
+  pango_layout_get_pixel_extents(layout, NULL, &logical);
+
+  pango_font_description_free(font_desc);
+  g_object_unref(layout);
+  g_object_unref(context);
+
+  return n + 1 < G_N_ELEMENTS(sizes);
+}
+
+/* NULL waits for the thread, the steps after it need the module */
+static const tklock_prewarm_step prewarm_steps[] =
+{
+  tklock_prewarm_spawn,
+  tklock_prewarm_gconf,
+  tklock_prewarm_atoms,
+  tklock_prewarm_fonts,
+  NULL,
+  tklock_prewarm_icons
+};
+
+static gboolean tklock_prewarm_cb(gpointer user_data);
+
+static gboolean
+tklock_prewarm_poll_cb(gpointer user_data)
+{
+  if (!g_atomic_int_get(&prewarm_thread_done))
+    return TRUE;
+
+  prewarm_id = g_idle_add_full(G_PRIORITY_LOW, tklock_prewarm_cb, NULL, NULL);
+
+  return FALSE;
+}
+
+static gboolean
+tklock_prewarm_cb(gpointer user_data)
+{
+  gint64 start = g_get_monotonic_time();
+
+  do
+  {
+    tklock_prewarm_step step = prewarm_steps[prewarm_step];
+
+    if (!step)
+    {
+      if (prewarm_thread && !g_atomic_int_get(&prewarm_thread_done))
+      {
+        prewarm_id = g_timeout_add(TKLOCK_PREWARM_POLL,
+                                   tklock_prewarm_poll_cb, NULL);
+        return FALSE;
+      }
+
+      tklock_prewarm_thread_join();
+      prewarm_step++;
+    }
+    else if (step(prewarm_n))
+      prewarm_n++;
+    else
+    {
+      prewarm_step++;
+      prewarm_n = 0;
+    }
+  }
+  while (prewarm_step < G_N_ELEMENTS(prewarm_steps) &&
+         g_get_monotonic_time() - start < TKLOCK_PREWARM_SLICE);
+
+  if (prewarm_step < G_N_ELEMENTS(prewarm_steps))
+    return TRUE;
+
+  SYSTEMUI_DEBUG("prewarm done");
+  prewarm_id = 0;
+
+  return FALSE;
+}
+
+void
+tklock_prewarm_start()
+{
+  SYSTEMUI_DEBUG_FN;
+
+  if (prewarm_id || tklock_prewarm_done())
+    return;
+
+  prewarm_id = g_idle_add_full(G_PRIORITY_LOW, tklock_prewarm_cb, NULL, NULL);
+}
+
+static void
+tklock_prewarm_drop_gconf()
+{
+  if (prewarm_gconf)
+  {
+    gconf_client_remove_dir(prewarm_gconf, TKLOCK_GCONF_DIR, NULL);
+    g_object_unref(prewarm_gconf);
+    prewarm_gconf = NULL;
+  }
+}
+
+void
+tklock_prewarm_stop()
+{
+  SYSTEMUI_DEBUG_FN;
+
+  if (prewarm_id)
+  {
+    g_source_remove(prewarm_id);
+    prewarm_id = 0;
+  }
+
+  /* it stops after what it is at, a decode at most */
+  tklock_prewarm_thread_join();
+  tklock_prewarm_drop_gconf();
+
+  prewarm_step = 0;
+  prewarm_n = 0;
+}
+
+static gboolean
+tklock_prewarm_join_cb(gpointer user_data)
+{
+  if (!g_atomic_int_get(&prewarm_thread_done))
+    return TRUE;
+
+  prewarm_id = 0;
+  tklock_prewarm_thread_join();
+
+  /* a step it finished after the cancel would undo the trim */
+  tklock_visual_trim(NULL);
+  tklock_visual_release_db_memory();
+
+  return FALSE;
+}
+
+/*
+ * Memory pressure. Unlike tklock_prewarm_stop() this doesn't wait for the
+ * thread, it quits after its current step and is joined from the main loop
+ * later. The steps done so far stay done, the rest is left to the first lock.
+ */
+void
+tklock_prewarm_cancel()
+{
+  SYSTEMUI_DEBUG_FN;
+
+  if (prewarm_id)
+  {
+    g_source_remove(prewarm_id);
+    prewarm_id = 0;
+  }
+
+  tklock_prewarm_drop_gconf();
+
+  if (prewarm_thread)
+  {
+    g_atomic_int_set(&prewarm_quit, 1);
+    prewarm_id = g_timeout_add(TKLOCK_PREWARM_POLL, tklock_prewarm_join_cb,
+                               NULL);
+  }
+}
+
+gboolean
+tklock_prewarm_done()
+{
+  return prewarm_step >= G_N_ELEMENTS(prewarm_steps);
+}
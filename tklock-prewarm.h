@@ -0,0 +1,33 @@
+/**
+   @file tklock-prewarm.h
+
+   @brief Maemo systemui tklock plugin lock resources prewarm
+
+   Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+
+   This file is part of osso-systemui-tklock.
+
+   osso-systemui-tklock is free software;
+   you can redistribute it and/or modify it under the terms of the
+   GNU Lesser General Public License version 2.1 as published by the
+   Free Software Foundation.
+
+   osso-systemui-tklock is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with osso-systemui-powerkeymenu.
+   If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __TKLOCK_PREWARM_H__
+#define __TKLOCK_PREWARM_H__
+
+void tklock_prewarm_start();
+void tklock_prewarm_stop();
+void tklock_prewarm_cancel();
+gboolean tklock_prewarm_done();
+
+#endif /* __TKLOCK_PREWARM_H__ */
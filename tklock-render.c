@@ -0,0 +1,551 @@
+/**
+   @file tklock-render.c
+
+   @brief Maemo systemui tklock plugin single surface lock renderer
+
+   Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+
+   This file is part of osso-systemui-tklock.
+
+   osso-systemui-tklock is free software;
+   you can redistribute it and/or modify it under the terms of the
+   GNU Lesser General Public License version 2.1 as published by the
+   Free Software Foundation.
+
+   osso-systemui-tklock is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with osso-systemui-powerkeymenu.
+   If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Single surface lock screen: clock, date, hint text, missed events and the
+ * slider are all drawn straight into the lock window from one expose handler,
+ * instead of a tree of alignments, boxes, labels and images that has to be
+ * size-requested and allocated on every change. The layout is fixed, it is
+ * computed once per screen geometry, and every element owns a band of it, so
+ * a change only ever invalidates the band it lives in. The background is the
+ * window back pixmap, which X fills before we are called.
+ *
+ * In fake portrait everything is laid out as landscape and rotated when drawn,
+ * the slider gets the rotated rectangle and runs vertically.
+ */
+
+#include <gtk/gtk.h>
+#include <systemui.h>
+
+#include <string.h>
+#include <libintl.h>
+
+#include "visual-tklock.h"
+#include "tklock-slider.h"
+#include "tklock-render.h"
+
+#define TKLOCK_RENDER_CLOCK_FONT_SIZE 75
+#define TKLOCK_RENDER_COUNT_FONT_SIZE 25
+#define TKLOCK_RENDER_ICON_SIZE 48
+#define TKLOCK_RENDER_ICON_SPACING 8
+#define TKLOCK_RENDER_EVENT_SPACING 40
+#define TKLOCK_RENDER_SPACING 24
+
+struct _tklock_render
+{
+  GtkWidget *window;
+  gboolean fake_portrait;
+  gint screen_width;
+  gint screen_height;
+  /* logical, that is unrotated, size */
+  gint width;
+  gint height;
+  GdkRectangle time_rect;
+  GdkRectangle date_rect;
+  GdkRectangle slider_rect;
+  GdkRectangle hint_rect;
+  GdkRectangle events_rect;
+  PangoLayout *time_layout;
+  PangoLayout *date_layout;
+  PangoLayout *hint_layout;
+  PangoLayout *count_layouts[TKLOCK_RENDER_EVENT_COUNT];
+  GdkPixbuf *icons[TKLOCK_RENDER_EVENT_COUNT];
+  guint order[TKLOCK_RENDER_EVENT_COUNT];
+  guint counts[TKLOCK_RENDER_EVENT_COUNT];
+  gint events_width;
+  tklock_slider *slider;
+  tklock_slider_cb unlock_cb;
+  gpointer user_data;
+  gulong expose_id;
+};
+
+static void
+tklock_render_to_device(tklock_render *render, const GdkRectangle *logical,
+                        GdkRectangle *device)
+{
+  if (render->fake_portrait)
+  {
+    device->x = render->screen_width - (logical->y + logical->height);
+    device->y = logical->x;
+    device->width = logical->height;
+    device->height = logical->width;
+  }
+  else
+    *device = *logical;
+}
+
+static void
+tklock_render_invalidate(tklock_render *render, const GdkRectangle *logical)
+{
+  GdkRectangle device;
+
+  if (!GTK_WIDGET_DRAWABLE(render->window))
+    return;
+
+  tklock_render_to_device(render, logical, &device);
+  gdk_window_invalidate_rect(render->window->window, &device, FALSE);
+}
+
+static gboolean
+tklock_render_needs(tklock_render *render, GdkRegion *region,
+                    const GdkRectangle *logical)
+{
+  GdkRectangle device;
+
+  tklock_render_to_device(render, logical, &device);
+
+  return gdk_region_rect_in(region, &device) != GDK_OVERLAP_RECTANGLE_OUT;
+}
+
+static PangoLayout *
+tklock_render_create_layout(GtkWidget *widget, int size)
+{
+  PangoLayout *layout = gtk_widget_create_pango_layout(widget, NULL);
+
+  if (size)
+  {
+    PangoFontDescription *font_desc = pango_font_description_new();
+
+    pango_font_description_set_family(font_desc, "Nokia Sans");
+    pango_font_description_set_absolute_size(font_desc, size * PANGO_SCALE);
+    pango_layout_set_font_description(layout, font_desc);
+    pango_font_description_free(font_desc);
+  }
+
+  return layout;
+}
+
+static gint
+tklock_render_layout_width(PangoLayout *layout)
+{
+  PangoRectangle logical;
+
+  pango_layout_get_pixel_extents(layout, NULL, &logical);
+
+  return logical.width;
+}
+
+static gint
+tklock_render_layout_height(PangoLayout *layout)
+{
+  PangoRectangle logical;
+
+  pango_layout_get_pixel_extents(layout, NULL, &logical);
+
+  return logical.height;
+}
+
+static gint
+tklock_render_line_height(PangoLayout *layout)
+{
+  PangoRectangle logical;
+  PangoLayout *probe = pango_layout_copy(layout);
+
+  /* every band is one line high, whatever the text is */
+  pango_layout_set_text(probe, "0", -1);
+  pango_layout_get_pixel_extents(probe, NULL, &logical);
+  g_object_unref(probe);
+
+  return logical.height;
+}
+
+static void
+tklock_render_show_centered(cairo_t *cr, PangoLayout *layout,
+                            const GdkRectangle *band)
+{
+  cairo_move_to(cr,
+                band->x + (band->width - tklock_render_layout_width(layout)) / 2,
+                band->y);
+  pango_cairo_show_layout(cr, layout);
+}
+
+static void
+tklock_render_draw_events(tklock_render *render, cairo_t *cr)
+{
+  const GdkRectangle *band = &render->events_rect;
+  gint x = band->x + (band->width - render->events_width) / 2;
+  int i;
+
+  for (i = 0; i < TKLOCK_RENDER_EVENT_COUNT; i++)
+  {
+    PangoLayout *layout = render->count_layouts[i];
+    GdkPixbuf *icon;
+    PangoRectangle logical;
+
+    /* there is no layout for an out of range index */
+    if (!layout)
+      continue;
+
+    icon = render->icons[render->order[i]];
+
+    if (icon)
+    {
+      gdk_cairo_set_source_pixbuf(cr, icon, x, band->y);
+      cairo_paint(cr);
+    }
+
+    x += TKLOCK_RENDER_ICON_SIZE + TKLOCK_RENDER_ICON_SPACING;
+
+    pango_layout_get_pixel_extents(layout, NULL, &logical);
+    gdk_cairo_set_source_color(cr,
+                               &render->window->style->fg[GTK_STATE_NORMAL]);
+    cairo_move_to(cr, x, band->y + (band->height - logical.height) / 2);
+    pango_cairo_show_layout(cr, layout);
+
+    x += logical.width + TKLOCK_RENDER_EVENT_SPACING;
+  }
+}
+
+static gboolean
+tklock_render_expose_cb(GtkWidget *widget, GdkEventExpose *event,
+                        tklock_render *render)
+{
+  GtkStyle *style = widget->style;
+  GdkColor color;
+  cairo_t *cr;
+
+  cr = gdk_cairo_create(widget->window);
+  gdk_cairo_region(cr, event->region);
+  cairo_clip(cr);
+
+  if (render->fake_portrait)
+  {
+    cairo_translate(cr, render->screen_width, 0);
+    cairo_rotate(cr, G_PI / 2);
+  }
+
+  gdk_cairo_set_source_color(cr, &style->fg[GTK_STATE_NORMAL]);
+
+  if (tklock_render_needs(render, event->region, &render->time_rect))
+    tklock_render_show_centered(cr, render->time_layout, &render->time_rect);
+
+  /* centred by the layout itself, it is as wide as the band */
+  if (tklock_render_needs(render, event->region, &render->hint_rect))
+  {
+    cairo_move_to(cr, render->hint_rect.x, render->hint_rect.y);
+    pango_cairo_show_layout(cr, render->hint_layout);
+  }
+
+  if (tklock_render_needs(render, event->region, &render->date_rect))
+  {
+    if (!gtk_style_lookup_color(style, "SecondaryTextColor", &color))
+      color = style->fg[GTK_STATE_NORMAL];
+
+    gdk_cairo_set_source_color(cr, &color);
+    tklock_render_show_centered(cr, render->date_layout, &render->date_rect);
+  }
+
+  if (render->events_width &&
+      tklock_render_needs(render, event->region, &render->events_rect))
+  {
+    tklock_render_draw_events(render, cr);
+  }
+
+  cairo_destroy(cr);
+
+  /* the slider is drawn by the theme engine, rotation or not */
+  tklock_slider_paint(render->slider, &event->area);
+
+  return FALSE;
+}
+
+static void
+tklock_render_slider_unlock_cb(gpointer user_data)
+{
+  tklock_render *render = user_data;
+
+  if (render->unlock_cb)
+    render->unlock_cb(render->user_data);
+}
+
+static void
+tklock_render_attach_slider(tklock_render *render)
+{
+  GdkRectangle device;
+
+  tklock_render_to_device(render, &render->slider_rect, &device);
+  render->slider = tklock_slider_attach(render->window, &device,
+                                        render->fake_portrait,
+                                        tklock_render_slider_unlock_cb,
+                                        render);
+}
+
+/* recompute the layout, does nothing if the screen geometry is the same */
+void
+tklock_render_relayout(tklock_render *render)
+{
+  GdkScreen *screen = gdk_screen_get_default();
+  gint w = gdk_screen_get_width(screen);
+  gint h = gdk_screen_get_height(screen);
+  gint length;
+  gint y;
+
+  g_assert(render != NULL);
+
+  if (render->screen_width == w && render->screen_height == h)
+    return;
+
+  SYSTEMUI_DEBUG_FN;
+
+  render->screen_width = w;
+  render->screen_height = h;
+  render->width = render->fake_portrait ? h : w;
+  render->height = render->fake_portrait ? w : h;
+
+  y = render->height * 12 / 100;
+  render->time_rect.x = 0;
+  render->time_rect.y = y;
+  render->time_rect.width = render->width;
+  render->time_rect.height = tklock_render_line_height(render->time_layout);
+  y += render->time_rect.height + 4;
+
+  render->date_rect.x = 0;
+  render->date_rect.y = y;
+  render->date_rect.width = render->width;
+  render->date_rect.height = tklock_render_line_height(render->date_layout);
+  y += render->date_rect.height + TKLOCK_RENDER_SPACING;
+
+  length = render->width * 440 / 800;
+  render->slider_rect.x = (render->width - length) / 2;
+  render->slider_rect.y =
+      MAX(y, render->height * 55 / 100 - TKLOCK_SLIDER_BREADTH / 2);
+  render->slider_rect.width = length;
+  render->slider_rect.height = TKLOCK_SLIDER_BREADTH;
+  y = render->slider_rect.y + TKLOCK_SLIDER_BREADTH + TKLOCK_RENDER_SPACING;
+
+  /* long translations wrap instead of running off the screen */
+  render->hint_rect.x = TKLOCK_RENDER_SPACING;
+  render->hint_rect.y = y;
+  render->hint_rect.width = render->width - 2 * TKLOCK_RENDER_SPACING;
+  pango_layout_set_width(render->hint_layout,
+                         render->hint_rect.width * PANGO_SCALE);
+  render->hint_rect.height = tklock_render_layout_height(render->hint_layout);
+  y += render->hint_rect.height + TKLOCK_RENDER_SPACING;
+
+  render->events_rect.x = 0;
+  render->events_rect.y =
+      MAX(y, render->height - TKLOCK_RENDER_ICON_SIZE - 30);
+  render->events_rect.width = render->width;
+  render->events_rect.height = TKLOCK_RENDER_ICON_SIZE;
+
+  if (render->slider)
+    tklock_slider_detach(render->slider);
+
+  tklock_render_attach_slider(render);
+
+  if (GTK_WIDGET_DRAWABLE(render->window))
+    gdk_window_invalidate_rect(render->window->window, NULL, FALSE);
+}
+
+tklock_render *
+tklock_render_new(GtkWidget *window, gboolean fake_portrait,
+                  tklock_slider_cb unlock_cb, gpointer user_data)
+{
+  tklock_render *render = g_slice_new0(tklock_render);
+  GtkStyle *style;
+
+  SYSTEMUI_DEBUG_FN;
+
+  render->window = window;
+  render->fake_portrait = fake_portrait;
+  render->unlock_cb = unlock_cb;
+  render->user_data = user_data;
+
+  render->time_layout =
+      tklock_render_create_layout(window, TKLOCK_RENDER_CLOCK_FONT_SIZE);
+  render->date_layout = tklock_render_create_layout(window, 0);
+  render->hint_layout = tklock_render_create_layout(window, 0);
+
+  style = gtk_rc_get_style_by_paths(gtk_widget_get_settings(window),
+                                    "SystemFont", NULL, G_TYPE_NONE);
+
+  if (style)
+    pango_layout_set_font_description(render->hint_layout, style->font_desc);
+
+  pango_layout_set_wrap(render->hint_layout, PANGO_WRAP_WORD);
+  pango_layout_set_alignment(render->hint_layout, PANGO_ALIGN_CENTER);
+
+  pango_layout_set_text(render->hint_layout,
+                        dgettext("osso-system-lock", "secu_swipe_to_unlock"),
+                        -1);
+
+  tklock_render_relayout(render);
+
+  render->expose_id =
+      g_signal_connect_after(window, "expose-event",
+                             G_CALLBACK(tklock_render_expose_cb), render);
+
+  return render;
+}
+
+void
+tklock_render_set_time(tklock_render *render, const char *time_str,
+                       const char *date_str)
+{
+  g_assert(render != NULL);
+
+  if (g_strcmp0(pango_layout_get_text(render->time_layout), time_str))
+  {
+    pango_layout_set_text(render->time_layout, time_str, -1);
+    tklock_render_invalidate(render, &render->time_rect);
+  }
+
+  if (g_strcmp0(pango_layout_get_text(render->date_layout), date_str))
+  {
+    pango_layout_set_text(render->date_layout, date_str, -1);
+    tklock_render_invalidate(render, &render->date_rect);
+  }
+}
+
+static void
+tklock_render_clear_events(tklock_render *render)
+{
+  int i;
+
+  for (i = 0; i < TKLOCK_RENDER_EVENT_COUNT; i++)
+  {
+    if (render->count_layouts[i])
+    {
+      g_object_unref(render->count_layouts[i]);
+      render->count_layouts[i] = NULL;
+    }
+  }
+
+  render->events_width = 0;
+}
+
+/* events are shown in order, order[] holds indexes into events[] */
+void
+tklock_render_set_events(tklock_render *render, const event_t *events,
+                         const guint *order)
+{
+  guint counts[TKLOCK_RENDER_EVENT_COUNT];
+  int i;
+
+  g_assert(render != NULL);
+
+  for (i = 0; i < TKLOCK_RENDER_EVENT_COUNT; i++)
+  {
+    if (order[i] < TKLOCK_RENDER_EVENT_COUNT)
+      counts[i] = events[order[i]].count;
+    else
+      counts[i] = 0;
+  }
+
+  if (!memcmp(render->order, order, sizeof(render->order)) &&
+      !memcmp(render->counts, counts, sizeof(render->counts)))
+  {
+    return;
+  }
+
+  SYSTEMUI_DEBUG_FN;
+
+  memcpy(render->order, order, sizeof(render->order));
+  memcpy(render->counts, counts, sizeof(render->counts));
+  tklock_render_clear_events(render);
+
+  for (i = 0; i < TKLOCK_RENDER_EVENT_COUNT; i++)
+  {
+    guint idx = order[i];
+    char count_str[11];
+
+    if (!counts[i])
+      continue;
+
+    if (!render->icons[idx])
+      render->icons[idx] = visual_tklock_get_event_icon(idx);
+
+    g_snprintf(count_str, sizeof(count_str), "%u", counts[i]);
+    render->count_layouts[i] =
+        tklock_render_create_layout(render->window,
+                                    TKLOCK_RENDER_COUNT_FONT_SIZE);
+    pango_layout_set_text(render->count_layouts[i], count_str, -1);
+
+    if (render->events_width)
+      render->events_width += TKLOCK_RENDER_EVENT_SPACING;
+
+    render->events_width += TKLOCK_RENDER_ICON_SIZE +
+        TKLOCK_RENDER_ICON_SPACING +
+        tklock_render_layout_width(render->count_layouts[i]);
+  }
+
+  tklock_render_invalidate(render, &render->events_rect);
+}
+
+void
+tklock_render_reset_slider(tklock_render *render)
+{
+  g_assert(render != NULL);
+
+  tklock_slider_rewind(render->slider);
+}
+
+/* adds everything that might differ from an earlier frame to damage */
+void
+tklock_render_damage_live(tklock_render *render, GdkRegion *damage)
+{
+  const GdkRectangle *bands[] =
+  {
+    &render->time_rect,
+    &render->date_rect,
+    &render->slider_rect,
+    &render->events_rect
+  };
+  GdkRectangle device;
+  guint i;
+
+  g_assert(render != NULL);
+
+  for (i = 0; i < G_N_ELEMENTS(bands); i++)
+  {
+    tklock_render_to_device(render, bands[i], &device);
+    gdk_region_union_with_rect(damage, &device);
+  }
+}
+
+void
+tklock_render_destroy(tklock_render *render)
+{
+  int i;
+
+  SYSTEMUI_DEBUG_FN;
+
+  if (!render)
+    return;
+
+  g_signal_handler_disconnect(render->window, render->expose_id);
+  tklock_slider_detach(render->slider);
+  tklock_render_clear_events(render);
+
+  for (i = 0; i < TKLOCK_RENDER_EVENT_COUNT; i++)
+  {
+    if (render->icons[i])
+      g_object_unref(render->icons[i]);
+  }
+
+  g_object_unref(render->time_layout);
+  g_object_unref(render->date_layout);
+  g_object_unref(render->hint_layout);
+  g_slice_free(tklock_render, render);
+}
@@ -0,0 +1,44 @@
+/**
+   @file tklock-render.h
+
+   @brief Maemo systemui tklock plugin single surface lock renderer
+
+   Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+
+   This file is part of osso-systemui-tklock.
+
+   osso-systemui-tklock is free software;
+   you can redistribute it and/or modify it under the terms of the
+   GNU Lesser General Public License version 2.1 as published by the
+   Free Software Foundation.
+
+   osso-systemui-tklock is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with osso-systemui-powerkeymenu.
+   If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __TKLOCK_RENDER_H__
+#define __TKLOCK_RENDER_H__
+
+#define TKLOCK_RENDER_EVENT_COUNT 6
+
+typedef struct _tklock_render tklock_render;
+
+tklock_render *tklock_render_new(GtkWidget *window, gboolean fake_portrait,
+                                 tklock_slider_cb unlock_cb,
+                                 gpointer user_data);
+void tklock_render_set_time(tklock_render *render, const char *time_str,
+                            const char *date_str);
+void tklock_render_set_events(tklock_render *render, const event_t *events,
+                              const guint *order);
+void tklock_render_reset_slider(tklock_render *render);
+void tklock_render_damage_live(tklock_render *render, GdkRegion *damage);
+void tklock_render_relayout(tklock_render *render);
+void tklock_render_destroy(tklock_render *render);
+
+#endif /* __TKLOCK_RENDER_H__ */
@@ -0,0 +1,392 @@
+/**
+   @file tklock-scale.c
+
+   @brief Maemo systemui tklock plugin background rotate and scale kernels
+
+   Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+
+   This file is part of osso-systemui-tklock.
+
+   osso-systemui-tklock is free software;
+   you can redistribute it and/or modify it under the terms of the
+   GNU Lesser General Public License version 2.1 as published by the
+   Free Software Foundation.
+
+   osso-systemui-tklock is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with osso-systemui-powerkeymenu.
+   If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Rotate clockwise and scale in one pass, bilinear, straight into the
+ * destination pixbuf, instead of gdk_pixbuf_rotate_simple() followed by
+ * gdk_pixbuf_scale_simple() with two full size intermediate copies.
+ *
+ * Every destination pixel is blended from four source pixels. Which source
+ * pixels and with what weights only depends on the destination column on one
+ * axis and on the destination row on the other, so both are tabulated once and
+ * rotation is just a matter of which axis walks the source rows. Weights have
+ * 7 bits, so the differences fit signed 16 bit lanes; the SSE2, NEON and
+ * scalar paths do the very same arithmetic and give identical results. The
+ * SIMD paths blend four destination pixels at a time, every channel in a lane
+ * of its own. At 1:1 all weights are 0 and this is a plain (rotated) copy.
+ *
+ * Unlike GDK_INTERP_BILINEAR this does not average when shrinking a lot, the
+ * backgrounds are made for screens of about the same size.
+ */
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include <string.h>
+
+/*
+ * armhf only defines __ARM_NEON__ with -mfpu=neon, the Debian baseline has no
+ * NEON, debian/rules adds it. Without it this builds the scalar path only.
+ */
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define TKLOCK_SCALE_SIMD "sse2"
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define TKLOCK_SCALE_SIMD "neon"
+#endif
+
+/* destination pixels per SIMD step */
+#define TKLOCK_SCALE_SIMD_PIXELS 4
+
+#include "tklock-scale.h"
+
+typedef struct
+{
+  gsize off0;
+  gsize off1;
+  gint16 weight;
+} tklock_scale_tap;
+
+/*
+ * Maps dst_len pixel centers onto src_len source pixels, step bytes apart,
+ * walking the source backwards if reverse.
+ */
+static tklock_scale_tap *
+tklock_scale_taps(gint dst_len, gint src_len, gsize step, gboolean reverse)
+{
+  tklock_scale_tap *taps = g_new(tklock_scale_tap, dst_len);
+  gint64 max = (gint64)(src_len - 1) << 16;
+  gint i;
+
+  for (i = 0; i < dst_len; i++)
+  {
+    gint64 pos = (((gint64)(2 * i + 1) * src_len) << 16) / (2 * dst_len) -
+        32768;
+    gint p0;
+
+    pos = CLAMP(pos, 0, max);
+
+    if (reverse)
+      pos = max - pos;
+
+    p0 = pos >> 16;
+
+    taps[i].off0 = p0 * step;
+    taps[i].off1 = MIN(p0 + 1, src_len - 1) * step;
+    taps[i].weight = (pos & 0xffff) >> 9;
+  }
+
+  return taps;
+}
+
+/*
+ * 3 or 4 bytes, in memory order, the 4th one is 0 for RGB and never stored.
+ * RGB is put together in a register, a 3 byte memcpy() into the word would
+ * stall every load on store forwarding.
+ */
+static inline guint32
+tklock_scale_load(const guchar *p, gint n_channels)
+{
+  guint32 v;
+
+  if (n_channels == 4)
+  {
+    memcpy(&v, p, 4);
+    return v;
+  }
+
+  return GUINT32_TO_LE(p[0] | p[1] << 8 | p[2] << 16);
+}
+
+static inline void
+tklock_scale_store(guchar *p, guint32 v, gint n_channels)
+{
+  if (n_channels == 4)
+  {
+    memcpy(p, &v, 4);
+    return;
+  }
+
+  v = GUINT32_FROM_LE(v);
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+}
+
+static inline guint32
+tklock_scale_blend_scalar(guint32 t00, guint32 t01, guint32 t10, guint32 t11,
+                          gint wo, gint wi)
+{
+  guint32 rv = 0;
+  int shift;
+
+  for (shift = 0; shift < 32; shift += 8)
+  {
+    gint a = (t00 >> shift) & 0xff;
+    gint b = (t01 >> shift) & 0xff;
+    gint c = (t10 >> shift) & 0xff;
+    gint d = (t11 >> shift) & 0xff;
+    gint ac = a + (((c - a) * wo) >> 7);
+    gint bd = b + (((d - b) * wo) >> 7);
+
+    rv |= (guint32)(ac + (((bd - ac) * wi) >> 7)) << shift;
+  }
+
+  return rv;
+}
+
+/*
+ * The four source pixels of each of four destination pixels, t[0] to t[3]
+ * are the 00, 01, 10 and 11 taps. wi has each pixel's inner weight once per
+ * channel.
+ */
+#if defined(__SSE2__)
+static inline __m128i
+tklock_scale_lerp_simd(__m128i a, __m128i b, __m128i w)
+{
+  return _mm_add_epi16(a, _mm_srai_epi16(
+                         _mm_mullo_epi16(_mm_sub_epi16(b, a), w), 7));
+}
+
+static inline void
+tklock_scale_blend_simd(const guint32 t[4][TKLOCK_SCALE_SIMD_PIXELS],
+                        gint wo, const gint16 *wi, guint8 *out)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i vwo = _mm_set1_epi16(wo);
+  __m128i t00 = _mm_loadu_si128((const __m128i *)t[0]);
+  __m128i t01 = _mm_loadu_si128((const __m128i *)t[1]);
+  __m128i t10 = _mm_loadu_si128((const __m128i *)t[2]);
+  __m128i t11 = _mm_loadu_si128((const __m128i *)t[3]);
+  __m128i lo, hi;
+
+  /* first two pixels */
+  lo = tklock_scale_lerp_simd(
+        tklock_scale_lerp_simd(_mm_unpacklo_epi8(t00, zero),
+                               _mm_unpacklo_epi8(t10, zero), vwo),
+        tklock_scale_lerp_simd(_mm_unpacklo_epi8(t01, zero),
+                               _mm_unpacklo_epi8(t11, zero), vwo),
+        _mm_loadu_si128((const __m128i *)wi));
+  /* last two */
+  hi = tklock_scale_lerp_simd(
+        tklock_scale_lerp_simd(_mm_unpackhi_epi8(t00, zero),
+                               _mm_unpackhi_epi8(t10, zero), vwo),
+        tklock_scale_lerp_simd(_mm_unpackhi_epi8(t01, zero),
+                               _mm_unpackhi_epi8(t11, zero), vwo),
+        _mm_loadu_si128((const __m128i *)(wi + 8)));
+
+  _mm_storeu_si128((__m128i *)out, _mm_packus_epi16(lo, hi));
+}
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+static inline int16x8_t
+tklock_scale_lerp_simd(int16x8_t a, int16x8_t b, int16x8_t w)
+{
+  return vaddq_s16(a, vshrq_n_s16(vmulq_s16(vsubq_s16(b, a), w), 7));
+}
+
+static inline int16x8_t
+tklock_scale_widen_simd(uint8x8_t v)
+{
+  return vreinterpretq_s16_u16(vmovl_u8(v));
+}
+
+static inline void
+tklock_scale_blend_simd(const guint32 t[4][TKLOCK_SCALE_SIMD_PIXELS],
+                        gint wo, const gint16 *wi, guint8 *out)
+{
+  const int16x8_t vwo = vdupq_n_s16(wo);
+  uint8x16_t t00 = vreinterpretq_u8_u32(vld1q_u32(t[0]));
+  uint8x16_t t01 = vreinterpretq_u8_u32(vld1q_u32(t[1]));
+  uint8x16_t t10 = vreinterpretq_u8_u32(vld1q_u32(t[2]));
+  uint8x16_t t11 = vreinterpretq_u8_u32(vld1q_u32(t[3]));
+  int16x8_t lo, hi;
+
+  /* first two pixels */
+  lo = tklock_scale_lerp_simd(
+        tklock_scale_lerp_simd(tklock_scale_widen_simd(vget_low_u8(t00)),
+                               tklock_scale_widen_simd(vget_low_u8(t10)),
+                               vwo),
+        tklock_scale_lerp_simd(tklock_scale_widen_simd(vget_low_u8(t01)),
+                               tklock_scale_widen_simd(vget_low_u8(t11)),
+                               vwo),
+        vld1q_s16(wi));
+  /* last two */
+  hi = tklock_scale_lerp_simd(
+        tklock_scale_lerp_simd(tklock_scale_widen_simd(vget_high_u8(t00)),
+                               tklock_scale_widen_simd(vget_high_u8(t10)),
+                               vwo),
+        tklock_scale_lerp_simd(tklock_scale_widen_simd(vget_high_u8(t01)),
+                               tklock_scale_widen_simd(vget_high_u8(t11)),
+                               vwo),
+        vld1q_s16(wi + 8));
+
+  vst1q_u8(out, vcombine_u8(vqmovun_s16(lo), vqmovun_s16(hi)));
+}
+#endif
+
+/* rows of the destination pick the outer pair, columns the inner one */
+static void
+tklock_scale_run(const guchar *src, gint n_channels, guchar *dst,
+                 gint dst_stride, gint width, gint height,
+                 const tklock_scale_tap *outer, const tklock_scale_tap *inner,
+                 gboolean simd)
+{
+#ifdef TKLOCK_SCALE_SIMD
+  /* whole SIMD steps, the scalar loop does the rest of the row */
+  gint simd_width = simd ? width - width % TKLOCK_SCALE_SIMD_PIXELS : 0;
+  gint16 *wi = NULL;
+  gint i;
+#endif
+  gint x, y;
+
+#ifdef TKLOCK_SCALE_SIMD
+  if (simd_width)
+  {
+    wi = g_new(gint16, simd_width * 4);
+
+    for (x = 0; x < simd_width * 4; x++)
+      wi[x] = inner[x / 4].weight;
+  }
+#endif
+
+  for (y = 0; y < height; y++)
+  {
+    const guchar *o0 = src + outer[y].off0;
+    const guchar *o1 = src + outer[y].off1;
+    gint wo = outer[y].weight;
+    guchar *d = dst + y * dst_stride;
+
+    x = 0;
+
+#ifdef TKLOCK_SCALE_SIMD
+    for (; x < simd_width; x += TKLOCK_SCALE_SIMD_PIXELS)
+    {
+      guint32 t[4][TKLOCK_SCALE_SIMD_PIXELS];
+      guint8 out[4 * TKLOCK_SCALE_SIMD_PIXELS];
+
+      for (i = 0; i < TKLOCK_SCALE_SIMD_PIXELS; i++)
+      {
+        const tklock_scale_tap *tap = &inner[x + i];
+
+        t[0][i] = tklock_scale_load(o0 + tap->off0, n_channels);
+        t[1][i] = tklock_scale_load(o0 + tap->off1, n_channels);
+        t[2][i] = tklock_scale_load(o1 + tap->off0, n_channels);
+        t[3][i] = tklock_scale_load(o1 + tap->off1, n_channels);
+      }
+
+      if (n_channels == 4)
+      {
+        tklock_scale_blend_simd(t, wo, &wi[4 * x], d);
+        d += sizeof(out);
+        continue;
+      }
+
+      tklock_scale_blend_simd(t, wo, &wi[4 * x], out);
+
+      for (i = 0; i < TKLOCK_SCALE_SIMD_PIXELS; i++, d += n_channels)
+        memcpy(d, &out[4 * i], 3);
+    }
+#endif
+
+    for (; x < width; x++, d += n_channels)
+    {
+      const tklock_scale_tap *t = &inner[x];
+
+      tklock_scale_store(d, tklock_scale_blend_scalar(
+                           tklock_scale_load(o0 + t->off0, n_channels),
+                           tklock_scale_load(o0 + t->off1, n_channels),
+                           tklock_scale_load(o1 + t->off0, n_channels),
+                           tklock_scale_load(o1 + t->off1, n_channels),
+                           wo, t->weight), n_channels);
+    }
+  }
+
+#ifdef TKLOCK_SCALE_SIMD
+  g_free(wi);
+#endif
+}
+
+void
+tklock_scale_rotate_into(const GdkPixbuf *src, GdkPixbuf *dst,
+                         gboolean rotate, gboolean simd)
+{
+  gint n_channels = gdk_pixbuf_get_n_channels(src);
+  gint sw = gdk_pixbuf_get_width(src);
+  gint sh = gdk_pixbuf_get_height(src);
+  gsize stride = gdk_pixbuf_get_rowstride(src);
+  gint width = gdk_pixbuf_get_width(dst);
+  gint height = gdk_pixbuf_get_height(dst);
+  tklock_scale_tap *outer;
+  tklock_scale_tap *inner;
+
+  g_return_if_fail(gdk_pixbuf_get_colorspace(src) == GDK_COLORSPACE_RGB);
+  g_return_if_fail(gdk_pixbuf_get_bits_per_sample(src) == 8);
+  g_return_if_fail(gdk_pixbuf_get_n_channels(dst) == n_channels);
+
+  if (rotate)
+  {
+    /*
+     * Rotated clockwise, destination rows walk the source columns left to
+     * right and destination columns walk the source rows bottom up.
+     */
+    outer = tklock_scale_taps(height, sw, n_channels, FALSE);
+    inner = tklock_scale_taps(width, sh, stride, TRUE);
+  }
+  else
+  {
+    outer = tklock_scale_taps(height, sh, stride, FALSE);
+    inner = tklock_scale_taps(width, sw, n_channels, FALSE);
+  }
+
+  tklock_scale_run(gdk_pixbuf_get_pixels(src), n_channels,
+                   gdk_pixbuf_get_pixels(dst), gdk_pixbuf_get_rowstride(dst),
+                   width, height, outer, inner, simd);
+
+  g_free(outer);
+  g_free(inner);
+}
+
+GdkPixbuf *
+tklock_scale_rotate(const GdkPixbuf *src, gint width, gint height,
+                    gboolean rotate)
+{
+  GdkPixbuf *dst = gdk_pixbuf_new(GDK_COLORSPACE_RGB,
+                                  gdk_pixbuf_get_has_alpha(src), 8,
+                                  width, height);
+
+  if (dst)
+    tklock_scale_rotate_into(src, dst, rotate, TRUE);
+
+  return dst;
+}
+
+const char *
+tklock_scale_simd_name()
+{
+#ifdef TKLOCK_SCALE_SIMD
+  return TKLOCK_SCALE_SIMD;
+#else
+  return "none";
+#endif
+}
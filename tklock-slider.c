@@ -0,0 +1,414 @@
+/**
+   @file tklock-slider.c
+
+   @brief Maemo systemui tklock plugin unlock slider
+
+   Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+
+   This file is part of osso-systemui-tklock.
+
+   osso-systemui-tklock is free software;
+   you can redistribute it and/or modify it under the terms of the
+   GNU Lesser General Public License version 2.1 as published by the
+   Free Software Foundation.
+
+   osso-systemui-tklock is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with osso-systemui-powerkeymenu.
+   If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Slide-to-unlock drawing area. Unlike a GtkRange it only tracks the thumb
+ * offset in pixels, asks for compressed (hint) motion events and on every move
+ * invalidates just the area the thumb left and entered, so dragging costs the
+ * same no matter how big the trough is. The unlock decision is made here too:
+ * the thumb either reaches the end of the trough, or it is released past the
+ * middle while still moving fast enough towards the end.
+ *
+ * The same slider can be attached to an area of a window somebody else
+ * draws, in that case the host calls tklock_slider_paint() from its expose
+ * handler and events outside of the area are left to the host.
+ */
+
+#include <gtk/gtk.h>
+#include <systemui.h>
+
+#include "tklock-slider.h"
+
+#define TKLOCK_SLIDER_DATA "tklock-slider"
+
+/* thumb size along the trough, the breadth is the trough breadth */
+#define TKLOCK_SLIDER_THUMB_LENGTH 96
+
+/* released past that fraction of the trough unlocks, as the old hscale did */
+#define TKLOCK_SLIDER_RELEASE_THRESHOLD 0.875
+/* released past the middle at least that fast (px/ms) unlocks too */
+#define TKLOCK_SLIDER_FLING_VELOCITY 1.0
+
+struct _tklock_slider
+{
+  GtkWidget *widget;
+  GdkRectangle area;
+  gboolean attached;
+  gulong handlers[3];
+  gboolean vertical;
+  gint pos;
+  gint grab_offset;
+  gboolean dragging;
+  gboolean unlocked;
+  guint32 last_time;
+  gdouble velocity;
+  tklock_slider_cb unlock_cb;
+  gpointer user_data;
+};
+
+static gint
+tklock_slider_range(tklock_slider *slider)
+{
+  GdkRectangle *a = &slider->area;
+  gint len = slider->vertical ? a->height : a->width;
+
+  return MAX(len - TKLOCK_SLIDER_THUMB_LENGTH, 0);
+}
+
+static void
+tklock_slider_thumb_rect(tklock_slider *slider, gint pos, GdkRectangle *rect)
+{
+  GdkRectangle *a = &slider->area;
+
+  if (slider->vertical)
+  {
+    rect->x = a->x;
+    rect->y = a->y + pos;
+    rect->width = a->width;
+    rect->height = TKLOCK_SLIDER_THUMB_LENGTH;
+  }
+  else
+  {
+    rect->x = a->x + pos;
+    rect->y = a->y;
+    rect->width = TKLOCK_SLIDER_THUMB_LENGTH;
+    rect->height = a->height;
+  }
+}
+
+static void
+tklock_slider_move(tklock_slider *slider, gint pos)
+{
+  GdkRectangle old_rect;
+  GdkRectangle new_rect;
+
+  pos = CLAMP(pos, 0, tklock_slider_range(slider));
+
+  if (pos == slider->pos)
+    return;
+
+  if (GTK_WIDGET_DRAWABLE(slider->widget))
+  {
+    tklock_slider_thumb_rect(slider, slider->pos, &old_rect);
+    tklock_slider_thumb_rect(slider, pos, &new_rect);
+    gdk_rectangle_union(&old_rect, &new_rect, &new_rect);
+    gdk_window_invalidate_rect(slider->widget->window, &new_rect, FALSE);
+  }
+
+  slider->pos = pos;
+}
+
+static void
+tklock_slider_unlock(tklock_slider *slider)
+{
+  SYSTEMUI_DEBUG_FN;
+
+  slider->dragging = FALSE;
+  slider->unlocked = TRUE;
+  tklock_slider_move(slider, tklock_slider_range(slider));
+
+  if (slider->unlock_cb)
+    slider->unlock_cb(slider->user_data);
+}
+
+static gint
+tklock_slider_event_pos(tklock_slider *slider, gdouble x, gdouble y)
+{
+  return (gint)(slider->vertical ? y - slider->area.y : x - slider->area.x);
+}
+
+static gboolean
+tklock_slider_button_press_cb(GtkWidget *widget, GdkEventButton *event,
+                              tklock_slider *slider)
+{
+  GdkRectangle thumb;
+
+  if (event->type != GDK_BUTTON_PRESS || event->button != 1 ||
+      slider->unlocked)
+  {
+    return !slider->attached;
+  }
+
+  tklock_slider_thumb_rect(slider, slider->pos, &thumb);
+
+  /* no jumping to the press position, the thumb has to be dragged */
+  if (event->x < thumb.x || event->x >= thumb.x + thumb.width ||
+      event->y < thumb.y || event->y >= thumb.y + thumb.height)
+  {
+    return !slider->attached;
+  }
+
+  slider->dragging = TRUE;
+  slider->grab_offset = tklock_slider_event_pos(slider, event->x, event->y) -
+      slider->pos;
+  slider->last_time = event->time;
+  slider->velocity = 0.0;
+
+  return TRUE;
+}
+
+static gboolean
+tklock_slider_motion_notify_cb(GtkWidget *widget, GdkEventMotion *event,
+                               tklock_slider *slider)
+{
+  gint x, y;
+  gint old_pos;
+
+  if (!slider->dragging)
+    return !slider->attached;
+
+  /* coordinates of a hint might be stale, ask for the current ones */
+  if (event->is_hint)
+    gdk_window_get_pointer(widget->window, &x, &y, NULL);
+  else
+  {
+    x = event->x;
+    y = event->y;
+  }
+
+  old_pos = slider->pos;
+  tklock_slider_move(slider, tklock_slider_event_pos(slider, x, y) -
+                     slider->grab_offset);
+
+  if (event->time > slider->last_time)
+  {
+    gdouble v = (gdouble)(slider->pos - old_pos) /
+        (event->time - slider->last_time);
+
+    slider->velocity = 0.7 * slider->velocity + 0.3 * v;
+    slider->last_time = event->time;
+  }
+
+  if (slider->pos >= tklock_slider_range(slider))
+    tklock_slider_unlock(slider);
+
+  /* we are ready for the next motion event */
+  gdk_event_request_motions(event);
+
+  return TRUE;
+}
+
+static gboolean
+tklock_slider_button_release_cb(GtkWidget *widget, GdkEventButton *event,
+                                tklock_slider *slider)
+{
+  gint range = tklock_slider_range(slider);
+
+  if (!slider->dragging || event->button != 1)
+    return !slider->attached;
+
+  slider->dragging = FALSE;
+
+  SYSTEMUI_DEBUG("released at %d/%d, velocity %f px/ms", slider->pos, range,
+                 slider->velocity);
+
+  if (slider->pos >= range * TKLOCK_SLIDER_RELEASE_THRESHOLD ||
+      (slider->pos >= range / 2 &&
+       slider->velocity >= TKLOCK_SLIDER_FLING_VELOCITY))
+  {
+    tklock_slider_unlock(slider);
+  }
+  else
+    tklock_slider_move(slider, 0);
+
+  return TRUE;
+}
+
+void
+tklock_slider_paint(tklock_slider *slider, GdkRectangle *clip)
+{
+  GtkWidget *widget = slider->widget;
+  GdkRectangle thumb;
+  GdkRectangle area;
+
+  if (!gdk_rectangle_intersect(clip, &slider->area, &area))
+    return;
+
+  gtk_paint_box(widget->style, widget->window, GTK_WIDGET_STATE(widget),
+                GTK_SHADOW_IN, &area, widget, "trough", slider->area.x,
+                slider->area.y, slider->area.width, slider->area.height);
+
+  tklock_slider_thumb_rect(slider, slider->pos, &thumb);
+
+  if (gdk_rectangle_intersect(clip, &thumb, &area))
+  {
+    gtk_paint_slider(widget->style, widget->window,
+                     slider->dragging ? GTK_STATE_ACTIVE : GTK_STATE_NORMAL,
+                     GTK_SHADOW_OUT, &area, widget,
+                     slider->vertical ? "vscale" : "hscale",
+                     thumb.x, thumb.y, thumb.width, thumb.height,
+                     slider->vertical ? GTK_ORIENTATION_VERTICAL :
+                                        GTK_ORIENTATION_HORIZONTAL);
+  }
+}
+
+static gboolean
+tklock_slider_expose_cb(GtkWidget *widget, GdkEventExpose *event,
+                        tklock_slider *slider)
+{
+  tklock_slider_paint(slider, &event->area);
+
+  return TRUE;
+}
+
+static void
+tklock_slider_realize_cb(GtkWidget *widget, tklock_slider *slider)
+{
+  /* let the lock background show through the trough */
+  gdk_window_set_back_pixmap(widget->window, NULL, TRUE);
+}
+
+static void
+tklock_slider_size_allocate_cb(GtkWidget *widget, GtkAllocation *allocation,
+                               tklock_slider *slider)
+{
+  slider->area.width = allocation->width;
+  slider->area.height = allocation->height;
+
+  if (slider->unlocked)
+    slider->pos = tklock_slider_range(slider);
+  else
+    slider->pos = CLAMP(slider->pos, 0, tklock_slider_range(slider));
+}
+
+static void
+tklock_slider_free(gpointer data)
+{
+  g_slice_free(tklock_slider, data);
+}
+
+GtkWidget *
+tklock_slider_new(gboolean vertical, gint length, tklock_slider_cb unlock_cb,
+                  gpointer user_data)
+{
+  tklock_slider *slider = g_slice_new0(tklock_slider);
+
+  SYSTEMUI_DEBUG_FN;
+
+  slider->widget = gtk_drawing_area_new();
+  slider->vertical = vertical;
+  slider->unlock_cb = unlock_cb;
+  slider->user_data = user_data;
+
+  gtk_widget_set_name(slider->widget, vertical ?
+                        "sui-tklock-slider-portrait" : "sui-tklock-slider");
+
+  if (vertical)
+    gtk_widget_set_size_request(slider->widget, TKLOCK_SLIDER_BREADTH, length);
+  else
+    gtk_widget_set_size_request(slider->widget, length, TKLOCK_SLIDER_BREADTH);
+
+  gtk_widget_add_events(slider->widget,
+                        GDK_BUTTON_PRESS_MASK | GDK_BUTTON_RELEASE_MASK |
+                        GDK_BUTTON_MOTION_MASK | GDK_POINTER_MOTION_HINT_MASK);
+
+  g_signal_connect(slider->widget, "realize",
+                   G_CALLBACK(tklock_slider_realize_cb), slider);
+  g_signal_connect(slider->widget, "size-allocate",
+                   G_CALLBACK(tklock_slider_size_allocate_cb), slider);
+  g_signal_connect(slider->widget, "expose-event",
+                   G_CALLBACK(tklock_slider_expose_cb), slider);
+  g_signal_connect(slider->widget, "button-press-event",
+                   G_CALLBACK(tklock_slider_button_press_cb), slider);
+  g_signal_connect(slider->widget, "motion-notify-event",
+                   G_CALLBACK(tklock_slider_motion_notify_cb), slider);
+  g_signal_connect(slider->widget, "button-release-event",
+                   G_CALLBACK(tklock_slider_button_release_cb), slider);
+
+  g_object_set_data_full(G_OBJECT(slider->widget), TKLOCK_SLIDER_DATA, slider,
+                         tklock_slider_free);
+
+  return slider->widget;
+}
+
+/* slider in area of host, the host has to paint it */
+tklock_slider *
+tklock_slider_attach(GtkWidget *host, const GdkRectangle *area,
+                     gboolean vertical, tklock_slider_cb unlock_cb,
+                     gpointer user_data)
+{
+  tklock_slider *slider = g_slice_new0(tklock_slider);
+
+  SYSTEMUI_DEBUG_FN;
+
+  slider->widget = host;
+  slider->area = *area;
+  slider->attached = TRUE;
+  slider->vertical = vertical;
+  slider->unlock_cb = unlock_cb;
+  slider->user_data = user_data;
+
+  gtk_widget_add_events(host,
+                        GDK_BUTTON_PRESS_MASK | GDK_BUTTON_RELEASE_MASK |
+                        GDK_BUTTON_MOTION_MASK | GDK_POINTER_MOTION_HINT_MASK);
+
+  slider->handlers[0] =
+      g_signal_connect(host, "button-press-event",
+                       G_CALLBACK(tklock_slider_button_press_cb), slider);
+  slider->handlers[1] =
+      g_signal_connect(host, "motion-notify-event",
+                       G_CALLBACK(tklock_slider_motion_notify_cb), slider);
+  slider->handlers[2] =
+      g_signal_connect(host, "button-release-event",
+                       G_CALLBACK(tklock_slider_button_release_cb), slider);
+
+  return slider;
+}
+
+void
+tklock_slider_detach(tklock_slider *slider)
+{
+  guint i;
+
+  SYSTEMUI_DEBUG_FN;
+
+  g_assert(slider->attached);
+
+  for (i = 0; i < G_N_ELEMENTS(slider->handlers); i++)
+    g_signal_handler_disconnect(slider->widget, slider->handlers[i]);
+
+  tklock_slider_free(slider);
+}
+
+void
+tklock_slider_rewind(tklock_slider *slider)
+{
+  SYSTEMUI_DEBUG_FN;
+
+  slider->dragging = FALSE;
+  slider->unlocked = FALSE;
+  slider->velocity = 0.0;
+  tklock_slider_move(slider, 0);
+}
+
+void
+tklock_slider_reset(GtkWidget *widget)
+{
+  tklock_slider *slider = g_object_get_data(G_OBJECT(widget),
+                                            TKLOCK_SLIDER_DATA);
+
+  g_assert(slider != NULL);
+
+  tklock_slider_rewind(slider);
+}
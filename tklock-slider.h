@@ -0,0 +1,46 @@
+/**
+   @file tklock-slider.h
+
+   @brief Maemo systemui tklock plugin unlock slider
+
+   Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+
+   This file is part of osso-systemui-tklock.
+
+   osso-systemui-tklock is free software;
+   you can redistribute it and/or modify it under the terms of the
+   GNU Lesser General Public License version 2.1 as published by the
+   Free Software Foundation.
+
+   osso-systemui-tklock is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with osso-systemui-powerkeymenu.
+   If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __TKLOCK_SLIDER_H__
+#define __TKLOCK_SLIDER_H__
+
+/* trough breadth, the length is up to the caller */
+#define TKLOCK_SLIDER_BREADTH 70
+
+typedef struct _tklock_slider tklock_slider;
+typedef void (*tklock_slider_cb)(gpointer user_data);
+
+GtkWidget *tklock_slider_new(gboolean vertical, gint length,
+                             tklock_slider_cb unlock_cb, gpointer user_data);
+void tklock_slider_reset(GtkWidget *slider);
+
+tklock_slider *tklock_slider_attach(GtkWidget *host, const GdkRectangle *area,
+                                    gboolean vertical,
+                                    tklock_slider_cb unlock_cb,
+                                    gpointer user_data);
+void tklock_slider_detach(tklock_slider *slider);
+void tklock_slider_paint(tklock_slider *slider, GdkRectangle *clip);
+void tklock_slider_rewind(tklock_slider *slider);
+
+#endif /* __TKLOCK_SLIDER_H__ */
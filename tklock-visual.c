@@ -0,0 +1,244 @@
+/**
+   @file tklock-visual.c
+
+   @brief Maemo systemui tklock plugin visual lock module loader
+
+   Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+
+   This file is part of osso-systemui-tklock.
+
+   osso-systemui-tklock is free software;
+   you can redistribute it and/or modify it under the terms of the
+   GNU Lesser General Public License version 2.1 as published by the
+   Free Software Foundation.
+
+   osso-systemui-tklock is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with osso-systemui-powerkeymenu.
+   If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The visual lock lives in a module of its own, together with sqlite, hildon
+ * and the image code it needs, so systemui doesn't map any of that until a
+ * visual lock is shown or the prewarm gets to it. Everything vtklock related
+ * in the plugin goes through here.
+ *
+ * The module is never unloaded, GTK and GLib keep pointers to its callbacks
+ * long after the last lock is gone. Without vtklock there is nothing to do,
+ * so the wrappers that take one only need to check for NULL, the module is
+ * always there once a vtklock exists.
+ */
+
+#include <gtk/gtk.h>
+#include <dbus/dbus.h>
+#include <systemui.h>
+
+#include <dlfcn.h>
+#include <string.h>
+
+#include "visual-tklock.h"
+#include "tklock-visual.h"
+
+static const tklock_visual_ops *visual_ops = NULL;
+static gboolean load_failed = FALSE;
+static gint64 load_time = 0;
+G_LOCK_DEFINE_STATIC(visual_load);
+
+static void
+tklock_visual_load_locked()
+{
+  tklock_visual_module_ops_fn module_ops;
+  const tklock_visual_ops *ops = NULL;
+  gint64 start;
+  void *handle;
+
+  SYSTEMUI_DEBUG_FN;
+
+  start = g_get_monotonic_time();
+  handle = dlopen(TKLOCK_VISUAL_MODULE, RTLD_NOW | RTLD_LOCAL);
+
+  if (!handle)
+  {
+    SYSTEMUI_ERROR("failed to load visual lock module: %s", dlerror());
+    load_failed = TRUE;
+    return;
+  }
+
+  module_ops = (tklock_visual_module_ops_fn)dlsym(handle,
+                                                  TKLOCK_VISUAL_MODULE_ENTRY);
+
+  if (module_ops)
+    ops = module_ops();
+
+  if (!ops)
+  {
+    SYSTEMUI_ERROR("%s is not a visual lock module", TKLOCK_VISUAL_MODULE);
+    dlclose(handle);
+    load_failed = TRUE;
+    return;
+  }
+
+  load_time = g_get_monotonic_time() - start;
+  SYSTEMUI_DEBUG("visual lock module loaded in %" G_GINT64_FORMAT " us",
+                 load_time);
+  g_atomic_pointer_set(&visual_ops, ops);
+}
+
+/*
+ * The prewarm loads the module from its thread, a lock shown meanwhile waits
+ * for it here instead of loading it a second time.
+ */
+gboolean
+tklock_visual_load()
+{
+  gboolean loaded;
+
+  if (g_atomic_pointer_get(&visual_ops))
+    return TRUE;
+
+  G_LOCK(visual_load);
+
+  /* don't retry on every lock, it won't appear by itself */
+  if (!visual_ops && !load_failed)
+    tklock_visual_load_locked();
+
+  loaded = visual_ops != NULL;
+  G_UNLOCK(visual_load);
+
+  return loaded;
+}
+
+/* NULL until the module is loaded */
+static const tklock_visual_ops *
+tklock_visual_ops_get()
+{
+  return g_atomic_pointer_get(&visual_ops);
+}
+
+/* 0 until the module is loaded */
+gint64
+tklock_visual_load_time()
+{
+  return load_time;
+}
+
+vtklock_t *
+tklock_visual_new(DBusConnection *conn, void (*unlock_handler)())
+{
+  vtklock_t *vtklock;
+
+  if (!tklock_visual_load())
+    return NULL;
+
+  vtklock = visual_ops->new(conn);
+
+  if (vtklock)
+    visual_ops->set_unlock_handler(vtklock, unlock_handler);
+
+  return vtklock;
+}
+
+void
+tklock_visual_create_view(vtklock_t *vtklock)
+{
+  if (vtklock)
+    visual_ops->create_view_whimsy(vtklock);
+}
+
+void
+tklock_visual_present_view(vtklock_t *vtklock, gboolean deferred)
+{
+  if (vtklock)
+    visual_ops->present_view(vtklock, deferred);
+}
+
+void
+tklock_visual_paint_deferred(vtklock_t *vtklock)
+{
+  if (vtklock)
+    visual_ops->paint_deferred(vtklock);
+}
+
+void
+tklock_visual_hide_lock(vtklock_t *vtklock)
+{
+  if (vtklock)
+    visual_ops->hide_lock(vtklock);
+}
+
+void
+tklock_visual_destroy_lock(vtklock_t *vtklock)
+{
+  if (vtklock)
+    visual_ops->destroy_lock(vtklock);
+}
+
+void
+tklock_visual_destroy(vtklock_t *vtklock)
+{
+  if (vtklock)
+    visual_ops->destroy(vtklock);
+}
+
+/* the caches may be filled by the prewarm before there is any vtklock */
+void
+tklock_visual_get_memory(vtklock_t *vtklock, vtklock_memory *mem)
+{
+  const tklock_visual_ops *ops = tklock_visual_ops_get();
+
+  if (ops)
+    ops->get_memory(vtklock, mem);
+  else
+    memset(mem, 0, sizeof(*mem));
+}
+
+void
+tklock_visual_trim(vtklock_t *vtklock)
+{
+  const tklock_visual_ops *ops = tklock_visual_ops_get();
+
+  if (ops)
+    ops->trim(vtklock);
+}
+
+GdkPixbuf *
+tklock_visual_get_event_icon(guint index)
+{
+  const tklock_visual_ops *ops = tklock_visual_ops_get();
+
+  return ops ? ops->get_event_icon(index) : NULL;
+}
+
+/* safe to call from any thread */
+void
+tklock_visual_prewarm_background(gboolean portrait, gint width, gint height)
+{
+  const tklock_visual_ops *ops = tklock_visual_ops_get();
+
+  if (ops)
+    ops->prewarm_background(portrait, width, height);
+}
+
+/* safe to call from any thread */
+void
+tklock_visual_prewarm_db()
+{
+  const tklock_visual_ops *ops = tklock_visual_ops_get();
+
+  if (ops)
+    ops->prewarm_db();
+}
+
+/* sqlite is only mapped with the module */
+int
+tklock_visual_release_db_memory()
+{
+  const tklock_visual_ops *ops = tklock_visual_ops_get();
+
+  return ops ? ops->release_db_memory() : 0;
+}
@@ -0,0 +1,71 @@
+/**
+   @file tklock-visual.h
+
+   @brief Maemo systemui tklock plugin visual lock module loader
+
+   Copyright (C) 2026 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+
+   This file is part of osso-systemui-tklock.
+
+   osso-systemui-tklock is free software;
+   you can redistribute it and/or modify it under the terms of the
+   GNU Lesser General Public License version 2.1 as published by the
+   Free Software Foundation.
+
+   osso-systemui-tklock is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with osso-systemui-powerkeymenu.
+   If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __TKLOCK_VISUAL_H__
+#define __TKLOCK_VISUAL_H__
+
+#define TKLOCK_VISUAL_MODULE "/usr/lib/systemui/tklock/libtklock-visual.so"
+#define TKLOCK_VISUAL_MODULE_ENTRY "tklock_visual_module_ops"
+/* everything else is built with -fvisibility=hidden */
+#define TKLOCK_EXPORT __attribute__((visibility("default")))
+
+/* what the visual lock module gives the plugin, see visual-tklock.h */
+typedef struct {
+  vtklock_t *(*new)(DBusConnection *conn);
+  void (*set_unlock_handler)(vtklock_t *vtklock, void (*handler)());
+  void (*create_view_whimsy)(vtklock_t *vtklock);
+  void (*present_view)(vtklock_t *vtklock, gboolean deferred);
+  void (*paint_deferred)(vtklock_t *vtklock);
+  void (*hide_lock)(vtklock_t *vtklock);
+  void (*destroy_lock)(vtklock_t *vtklock);
+  void (*destroy)(vtklock_t *vtklock);
+  void (*get_memory)(vtklock_t *vtklock, vtklock_memory *mem);
+  void (*trim)(vtklock_t *vtklock);
+  GdkPixbuf *(*get_event_icon)(guint index);
+  void (*prewarm_background)(gboolean portrait, gint width, gint height);
+  void (*prewarm_db)();
+  int (*release_db_memory)();
+} tklock_visual_ops;
+
+typedef const tklock_visual_ops *(*tklock_visual_module_ops_fn)();
+
+gboolean tklock_visual_load();
+gint64 tklock_visual_load_time();
+
+vtklock_t *tklock_visual_new(DBusConnection *conn, void (*unlock_handler)());
+void tklock_visual_create_view(vtklock_t *vtklock);
+void tklock_visual_present_view(vtklock_t *vtklock, gboolean deferred);
+void tklock_visual_paint_deferred(vtklock_t *vtklock);
+void tklock_visual_hide_lock(vtklock_t *vtklock);
+void tklock_visual_destroy_lock(vtklock_t *vtklock);
+void tklock_visual_destroy(vtklock_t *vtklock);
+void tklock_visual_get_memory(vtklock_t *vtklock, vtklock_memory *mem);
+void tklock_visual_trim(vtklock_t *vtklock);
+GdkPixbuf *tklock_visual_get_event_icon(guint index);
+void tklock_visual_prewarm_background(gboolean portrait, gint width,
+                                      gint height);
+void tklock_visual_prewarm_db();
+int tklock_visual_release_db_memory();
+
+#endif /* __TKLOCK_VISUAL_H__ */
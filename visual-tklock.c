@@ -17,11 +17,24 @@
 
 #include "visual-tklock.h"
 #include "tklock-grab.h"
+#include "tklock-common.h"
+#include "tklock-visual.h"
+#include "tklock-slider.h"
+#include "tklock-clock.h"
+#include "tklock-render.h"
+#include "tklock-baked.h"
+#include "tklock-scale.h"
 
 #define HILDON_BACKGROUNDS_DIR "/etc/hildon/theme/backgrounds/"
 #define LOCKSLIDER_BACKGROUND HILDON_BACKGROUNDS_DIR "lockslider.png"
 #define LOCKSLIDER_PORTRAIT_BACKGROUND HILDON_BACKGROUNDS_DIR "lockslider-portrait.png"
 #define TKLOCK_AUTO_ROTATION "/system/systemui/tklock/auto_rotation"
+#define TKLOCK_GESTURE_SLIDER "/system/systemui/tklock/gesture_slider"
+#define TKLOCK_DRAG_STATS "/system/systemui/tklock/drag_stats"
+#define TKLOCK_CAIRO_RENDERER "/system/systemui/tklock/cairo_renderer"
+
+/* how often to check if the background thread is done, in ms */
+#define BACKGROUNDS_POLL 50
 
 #define DBUS_CLOCKD_MATCH_RULE \
   "type='signal',sender='com.nokia.clockd'," \
@@ -32,6 +45,12 @@
 static guint event_idx[6];
 guint event_count = 0;
 
+static void visual_tklock_create_view_content(vtklock_t *vtklock);
+static void visual_tklock_destroy_view_content(vtklock_t *vtklock);
+static gboolean get_missed_events_from_db(vtklock_t *vtklock);
+static void visual_tklock_destroy_spare_layout(vtklock_t *vtklock);
+static void cancel_backgrounds(vtklock_t *vtklock);
+
 static void
 set_gdk_property(GtkWidget *widget, GdkAtom property, guint value)
 {
@@ -54,11 +73,17 @@ reset_slider(vtklock_t *vtklock)
   SYSTEMUI_DEBUG_FN;
 
   g_assert(vtklock != NULL);
-  g_assert(vtklock->slider != NULL && GTK_IS_RANGE(vtklock->slider));
+  g_assert(vtklock->slider != NULL || vtklock->render != NULL);
 
   vtklock->slider_value = 3.0;
   vtklock->slider_status = 1;
-  gtk_range_set_value(GTK_RANGE(vtklock->slider), vtklock->slider_value);
+
+  if (vtklock->render)
+    tklock_render_reset_slider(vtklock->render);
+  else if (GTK_IS_RANGE(vtklock->slider))
+    gtk_range_set_value(GTK_RANGE(vtklock->slider), vtklock->slider_value);
+  else
+    tklock_slider_reset(vtklock->slider);
 
   return TRUE;
 }
@@ -92,46 +117,94 @@ value_changed_cb(GtkRange *range, gpointer user_data)
   }
 }
 
-static gboolean
-update_timestamp(gpointer user_data)
+static void
+damage_widget(GdkRegion *damage, GtkWidget *widget)
 {
-  vtklockts *ts = user_data;
-  char time_buf[256];
-  GConfClient *gc;
+  if (damage && widget && GTK_WIDGET_DRAWABLE(widget))
+    gdk_region_union_with_rect(damage, &widget->allocation);
+}
+
+/*
+ * Reserve the clock extents for every hour of the current format and every
+ * weekday/month combination, digits are fixed width so minutes and days do
+ * not matter. Clock ticks never change the timestamp box geometry after this.
+ */
+static void
+reserve_timestamp_extents(vtklockts *ts)
+{
+  gboolean is_24h = tklock_time_format_is_24h();
+  char buf[256];
   struct tm tm;
-  const char *msgid;
 
-  g_assert(ts != NULL);
+  memset(&tm, 0, sizeof(tm));
+  tm.tm_year = 100;
+  tm.tm_mday = 28;
+
+  for (tm.tm_hour = 0; tm.tm_hour < 24; tm.tm_hour++)
+  {
+    tklock_format_time(&tm, is_24h, buf, sizeof(buf));
+    tklock_clock_reserve(ts->time_label, buf);
+  }
+
+  for (tm.tm_mon = 0; tm.tm_mon < 12; tm.tm_mon++)
+  {
+    for (tm.tm_wday = 0; tm.tm_wday < 7; tm.tm_wday++)
+    {
+      tklock_format_date(&tm, buf, sizeof(buf));
+      tklock_clock_reserve(ts->date_label, buf);
+    }
+  }
+}
+
+/*
+ * labels that changed are added to damage, if not NULL. The cairo renderer
+ * invalidates what changed by itself.
+ */
+static void
+set_timestamp(vtklock_t *vtklock, GdkRegion *damage)
+{
+  vtklockts *ts = &vtklock->ts;
+  char time_buf[256];
+  char date_buf[256];
+  struct tm tm;
 
   time_get_synced();
 
   if (time_get_local(&tm) != 0)
     memset(&tm, 0, sizeof(tm));
 
-  gc = gconf_client_get_default();
+  tklock_format_time(&tm, tklock_time_format_is_24h(), time_buf,
+                     sizeof(time_buf));
+  tklock_format_date(&tm, date_buf, sizeof(date_buf));
 
-  g_assert(gc);
+  if (vtklock->render)
+  {
+    tklock_render_set_time(vtklock->render, time_buf, date_buf);
+    return;
+  }
 
-  if (gconf_client_get_bool(gc, "/apps/clock/time-format", FALSE))
-    msgid = "wdgt_va_24h_time";
-  else if (tm.tm_hour > 11)
-    msgid = "wdgt_va_12h_time_pm";
-  else
-    msgid = "wdgt_va_12h_time_am";
+  g_assert(ts->time_label != NULL);
 
-  time_format_time(&tm, dgettext("hildon-libs", msgid), time_buf,
-                   sizeof(time_buf) - 1);
+  if (tklock_clock_set_text(ts->time_label, time_buf))
+    damage_widget(damage, ts->time_label);
 
-  if (g_strcmp0(gtk_label_get_text(GTK_LABEL(ts->time_label)), time_buf))
-    gtk_label_set_text(GTK_LABEL(ts->time_label), time_buf);
+  if (tklock_clock_set_text(ts->date_label, date_buf))
+    damage_widget(damage, ts->date_label);
+}
 
-  time_format_time(&tm, dgettext("hildon-libs", "wdgt_va_date_long"), time_buf,
-                   sizeof(time_buf) - 1);
+static gboolean
+update_timestamp(gpointer user_data)
+{
+  vtklock_t *vtklock = user_data;
+  guint size_requests = vtklock->size_requests;
 
-  if (g_strcmp0(gtk_label_get_text(GTK_LABEL(ts->date_label)), time_buf))
-    gtk_label_set_text(GTK_LABEL(ts->date_label), time_buf);
+  set_timestamp(vtklock, NULL);
+  vtklock->clock_ticks++;
 
-  g_object_unref(gc);
+  /* the resize is queued, so it shows up on the next tick at the latest */
+  SYSTEMUI_DEBUG("clock tick, %u size requests since the last one",
+                 size_requests - vtklock->tick_size_requests);
+  vtklock->tick_size_requests = size_requests;
 
   return TRUE;
 }
@@ -174,251 +247,717 @@ change_value_cb(GtkRange *range, GtkScrollType scroll, gdouble value,
   return TRUE;
 }
 
-static gboolean
-visual_tklock_map_cb(GtkWidget *widget, GdkEvent *event, vtklock_t *vtklock)
+static void
+vtklock_time_stats_add(vtklock_time_stats *stats, gint64 elapsed)
 {
-  SYSTEMUI_DEBUG_FN;
-
-  g_assert(vtklock != NULL);
-
-  if (!tklock_grab_try(vtklock->window->window, TRUE,
-                       GDK_BUTTON_PRESS_MASK | GDK_BUTTON_RELEASE_MASK,
-                       vtklock->window->window))
-  {
-    SYSTEMUI_ERROR("GRAB FAILED (systemui grab), visual tklock can't be "
-                   "enabled, request display unblank");
-    tklock_unlock(vtklock->systemui_conn);
-  }
-  else if (gtk_grab_get_current())
-    gtk_grab_add(vtklock->window);
+  stats->count++;
+  stats->total_us += elapsed;
 
-  return TRUE;
+  if (elapsed > stats->max_us)
+    stats->max_us = elapsed;
 }
 
-void
-visual_tklock_present_view(vtklock_t *vtklock)
+/*
+ * Emission hooks on GtkWidget::event and ::event-after bracket the handling of
+ * each event while the lock is mapped, so the slider drag cost can be measured
+ * the same way for both the hildon scale and the gesture slider, no matter who
+ * handles the events and where the paint happens. Unlike a handler set with
+ * gdk_event_handler_set() they leave the one systemui runs with alone.
+ */
+static GtkWidget *
+vtklock_drag_stats_slider(vtklock_t *vtklock)
 {
-  SYSTEMUI_DEBUG_FN;
-
-  g_assert(vtklock != NULL);
-
-  update_timestamp(&vtklock->ts);
-
-  g_signal_connect_after(vtklock->window, "map-event",
-                         G_CALLBACK(visual_tklock_map_cb), vtklock);
-
-  gtk_widget_realize(vtklock->window);
-  gdk_flush();
-
-  ipm_show_window(vtklock->window, vtklock->priority);
-  gdk_window_invalidate_rect(vtklock->window->window, NULL, TRUE);
-  gdk_window_process_all_updates();
-  gdk_flush();
-
-  if (!vtklock->update_timestamp_id)
-  {
-    vtklock->update_timestamp_id =
-        g_timeout_add(1000, update_timestamp, &vtklock->ts);
-  }
+  /* the cairo renderer has no slider widget, it is the window itself */
+  return vtklock->render ? vtklock->window : vtklock->slider;
 }
 
+/* returns which of drag_event_start[] the event is measured in, or -1 */
 static int
-convert_str_to_index(const char *str)
+vtklock_drag_stats_event(vtklock_t *vtklock, const GValue *param_values,
+                         GdkEvent **event)
 {
-  if (!strcmp("chat-message", str))
-    return 0;
+  GtkWidget *widget = g_value_get_object(&param_values[0]);
+  GtkWidget *slider = vtklock_drag_stats_slider(vtklock);
 
-  if (!strcmp("sms-message", str))
+  *event = g_value_get_boxed(&param_values[1]);
+
+  /* only where the event was sent to, not the parents it propagates to */
+  if (!slider || widget != gtk_get_event_widget(*event))
+    return -1;
+
+  if ((*event)->type == GDK_MOTION_NOTIFY && widget == slider)
     return 0;
 
-  if (!strcmp("auth-request", str))
+  if ((*event)->type == GDK_EXPOSE &&
+      (widget == slider || widget == vtklock->window))
+  {
     return 1;
+  }
 
-  if (!strcmp("chat-invitation", str))
-    return 2;
+  return -1;
+}
 
-  if (!strcmp("missed-call", str))
-    return 3;
+static gboolean
+vtklock_drag_stats_event_hook(GSignalInvocationHint *ihint,
+                              guint n_param_values,
+                              const GValue *param_values, gpointer data)
+{
+  vtklock_t *vtklock = data;
+  GdkEvent *event;
+  int i = vtklock_drag_stats_event(vtklock, param_values, &event);
 
-  if (!strcmp("email-message", str))
-    return 4;
+  if (i < 0)
+  {
+    if (event->type == GDK_BUTTON_PRESS &&
+        g_value_get_object(&param_values[0]) ==
+        vtklock_drag_stats_slider(vtklock))
+    {
+      vtklock->drag_stats.drags++;
+    }
 
-  if (!strcmp("voice-mail", str))
-    return 5;
+    return TRUE;
+  }
 
-  SYSTEMUI_WARNING("Unknown string! return -1");
+  vtklock->drag_event_request[i] =
+      NextRequest(GDK_DISPLAY_XDISPLAY(gdk_display_get_default()));
+  vtklock->drag_event_start[i] = g_get_monotonic_time();
 
-  return -1;
+  return TRUE;
 }
 
-static int
-get_missed_events_cb(void *user_data, int numcols, char **column_text,
-                     char **column_name)
+static gboolean
+vtklock_drag_stats_event_after_hook(GSignalInvocationHint *ihint,
+                                    guint n_param_values,
+                                    const GValue *param_values, gpointer data)
 {
-  vtklock_t *vtklock = (vtklock_t *)user_data;
-  int index;
+  vtklock_t *vtklock = data;
+  vtklock_drag_stats *stats = &vtklock->drag_stats;
+  GdkEvent *event;
+  int i = vtklock_drag_stats_event(vtklock, param_values, &event);
+  gint64 start, end;
 
-  SYSTEMUI_DEBUG_FN;
+  if (i < 0 || !vtklock->drag_event_start[i])
+    return TRUE;
 
-  g_assert(vtklock != NULL);
+  end = g_get_monotonic_time();
+  start = vtklock->drag_event_start[i];
+  vtklock->drag_event_start[i] = 0;
 
-  if (numcols != 3)
+  /* a paint forced from the motion handler is counted with the motion */
+  if (i == 0 || !vtklock->drag_event_start[0])
   {
-    SYSTEMUI_WARNING("select returned error values count");
-    return -1;
+    stats->x_requests +=
+        NextRequest(GDK_DISPLAY_XDISPLAY(gdk_display_get_default())) -
+        vtklock->drag_event_request[i];
   }
 
-  if (!column_text[0] || !column_text[1] || !column_text[2])
+  if (i == 0)
   {
-    SYSTEMUI_WARNING("select return error values");
-    return -1;
-  }
+    vtklock_time_stats_add(&stats->motion, end - start);
 
-  index = convert_str_to_index(column_text[0]);
+    if (!vtklock->drag_motion_start)
+      vtklock->drag_motion_start = start;
+  }
+  else
+  {
+    vtklock_time_stats_add(&stats->paint, end - start);
 
-  if (index == -1)
-    return 0;
+    if (vtklock->drag_motion_start)
+    {
+      vtklock_time_stats_add(&stats->motion_to_paint,
+                             end - vtklock->drag_motion_start);
+      vtklock->drag_motion_start = 0;
+    }
+  }
 
-  vtklock->event[index].hint = g_ascii_strtoll(column_text[1], NULL, 10);
-  vtklock->event[index].count += g_ascii_strtoll(column_text[2], NULL, 10);
+  return TRUE;
+}
 
-  event_count += vtklock->event[index].count;
+static void
+vtklock_drag_stats_install(vtklock_t *vtklock)
+{
+  if (!vtklock->drag_stats_enabled || vtklock->drag_event_hook)
+    return;
 
-  return 0;
+  vtklock->drag_event_hook = g_signal_add_emission_hook(
+        g_signal_lookup("event", GTK_TYPE_WIDGET), 0,
+        vtklock_drag_stats_event_hook, vtklock, NULL);
+  vtklock->drag_event_after_hook = g_signal_add_emission_hook(
+        g_signal_lookup("event-after", GTK_TYPE_WIDGET), 0,
+        vtklock_drag_stats_event_after_hook, vtklock, NULL);
 }
 
+/* what was measured while the lock was up, tklock-drag.sh collects these */
 static void
-get_missed_events_from_db(vtklock_t *vtklock)
+vtklock_drag_stats_log(vtklock_t *vtklock)
 {
-  sqlite3 *pdb;
-  char *sql;
-  char *errmsg = NULL;
-  int i, j;
-  gchar *db_fname;
-  struct stat stat_buf;
-
-  SYSTEMUI_DEBUG_FN;
+  vtklock_drag_stats *d = &vtklock->drag_stats;
 
-  memset(&stat_buf, 0, sizeof(stat_buf));
+  if (!d->motion.count)
+    return;
 
-  db_fname = g_build_filename(g_get_home_dir(),
-                              ".config/hildon-desktop/notifications.db", NULL);
+  SYSTEMUI_NOTICE("slider drags: %u, %u motion events, avg %" G_GINT64_FORMAT
+                  " us, max %" G_GINT64_FORMAT " us, %lu X requests",
+                  d->drags, d->motion.count, d->motion.total_us /
+                  d->motion.count, d->motion.max_us, d->x_requests);
 
-  if (db_fname)
+  if (d->paint.count)
   {
-    if (stat(db_fname, &stat_buf))
-      SYSTEMUI_NOTICE("error in reading db file info [%s]", db_fname);
+    SYSTEMUI_NOTICE("slider paints: %u, avg %" G_GINT64_FORMAT " us, max %"
+                    G_GINT64_FORMAT " us", d->paint.count,
+                    d->paint.total_us / d->paint.count, d->paint.max_us);
   }
-  else
-    SYSTEMUI_ERROR("g_build_filename returned NULL");
-
-  if (vtklock->db_mtime == stat_buf.st_mtime)
-    goto out;
-
-  event_count = 0;
 
-  for (i = 0; i < G_N_ELEMENTS(vtklock->event); i++)
+  if (d->motion_to_paint.count)
   {
-    vtklock->event[i].count = 0;
-    vtklock->event[i].hint = 0;
-    event_idx[i] = i;
+    SYSTEMUI_NOTICE("slider motion to paint: avg %" G_GINT64_FORMAT
+                    " us, max %" G_GINT64_FORMAT " us",
+                    d->motion_to_paint.total_us / d->motion_to_paint.count,
+                    d->motion_to_paint.max_us);
   }
 
-  if (!db_fname)
-    goto out;
+  memset(d, 0, sizeof(*d));
+}
 
-  if (sqlite3_open_v2(db_fname, &pdb, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK)
-  {
-    SYSTEMUI_WARNING("error in opening db [%s]", db_fname);
-    goto db_close_out;
-  }
+static void
+vtklock_drag_stats_remove(vtklock_t *vtklock)
+{
+  if (!vtklock->drag_event_hook)
+    return;
 
-  sql = sqlite3_mprintf(
-        "SELECT H.value, H2.value, COUNT(*) "
-        "FROM notifications N, hints H, hints H2 "
-        "WHERE N.id=H.nid AND H.id='category' and H2.id = 'time' and H2.nid = H.nid "
-        "GROUP BY  H.value "
-        "ORDER BY H2.value;");
+  vtklock_drag_stats_log(vtklock);
+
+  g_signal_remove_emission_hook(g_signal_lookup("event", GTK_TYPE_WIDGET),
+                                vtklock->drag_event_hook);
+  g_signal_remove_emission_hook(g_signal_lookup("event-after",
+                                                GTK_TYPE_WIDGET),
+                                vtklock->drag_event_after_hook);
+  vtklock->drag_event_hook = 0;
+  vtklock->drag_event_after_hook = 0;
+  vtklock->drag_event_start[0] = 0;
+  vtklock->drag_event_start[1] = 0;
+  vtklock->drag_motion_start = 0;
+}
 
-  if (sqlite3_exec(
-        pdb, sql, get_missed_events_cb, vtklock, &errmsg) != SQLITE_OK)
-  {
-     SYSTEMUI_WARNING("Unable to get data about missed events from db: %s",
-                      errmsg);
-     sqlite3_free(errmsg);
-  }
+static gboolean
+visual_tklock_map_cb(GtkWidget *widget, GdkEvent *event, vtklock_t *vtklock)
+{
+  SYSTEMUI_DEBUG_FN;
 
-  sqlite3_free(sql);
+  g_assert(vtklock != NULL);
 
-  /* Lame 'ORDER BY count DESC' loop */
-  for (i = 0; i < G_N_ELEMENTS(vtklock->event); i++)
+  if (!tklock_grab_try(vtklock->window->window, TRUE,
+                       GDK_BUTTON_PRESS_MASK | GDK_BUTTON_RELEASE_MASK,
+                       vtklock->window->window))
   {
-    for (j = i; j < G_N_ELEMENTS(vtklock->event); j++)
-    {
-      if (vtklock->event[i].count < vtklock->event[j].count)
-      {
-        guint tmp = event_idx[i];
-
-        event_idx[i] = event_idx[j];
-        event_idx[j] = tmp;
-      }
-    }
+    SYSTEMUI_ERROR("GRAB FAILED (systemui grab), visual tklock can't be "
+                   "enabled, request display unblank");
+    tklock_unlock(vtklock->systemui_conn);
   }
+  else if (gtk_grab_get_current())
+    gtk_grab_add(vtklock->window);
 
-  vtklock->db_mtime = stat_buf.st_mtime;
-
-db_close_out:
-  sqlite3_close(pdb);
+  vtklock_drag_stats_install(vtklock);
 
-out:
-  g_free(db_fname);
+  return TRUE;
 }
 
-static DBusHandlerResult
-handle_time_changed(DBusConnection *connection, DBusMessage *message,
-                    void *user_data)
+/* adds everything that might differ from an earlier frame to damage */
+static void
+visual_tklock_damage_live(vtklock_t *vtklock, GdkRegion *damage)
 {
-  vtklock_t *vtklock = user_data;
-
-  SYSTEMUI_DEBUG_FN;
-
-  if (dbus_message_get_type(message) == DBUS_MESSAGE_TYPE_SIGNAL &&
-      !g_strcmp0(dbus_message_get_member(message), CLOCKD_TIME_CHANGED))
+  if (vtklock->render)
+    tklock_render_damage_live(vtklock->render, damage);
+  else
   {
-    g_assert(vtklock != NULL);
-
-    time_get_synced();
-    update_timestamp(&vtklock->ts);
+    damage_widget(damage, vtklock->ts.time_label);
+    damage_widget(damage, vtklock->ts.date_label);
+    damage_widget(damage, vtklock->slider);
   }
-
-  return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 }
 
+/*
+ * The snapshot is the last painted lock screen, used as the window back pixmap
+ * when the lock is mapped, so X shows a complete frame before we paint
+ * anything. The clock in it is just a placeholder, the first expose is turned
+ * into repainting the clock, the slider and the event line only.
+ */
 static void
-install_dbus_handlers(vtklock_t *vtklock)
+visual_tklock_snapshot_hide(vtklock_t *vtklock)
 {
-  SYSTEMUI_DEBUG_FN;
-
-  g_assert(vtklock->systemui_conn != NULL);
-  g_assert(vtklock->dbus_filter_installed == FALSE);
+  if (!vtklock->snapshot_shown)
+    return;
 
-  dbus_bus_add_match(vtklock->systemui_conn, DBUS_CLOCKD_MATCH_RULE, NULL);
+  vtklock->snapshot_shown = FALSE;
 
-  if (!dbus_connection_add_filter(vtklock->systemui_conn, handle_time_changed,
-                                  vtklock, NULL))
+  if (vtklock->window && GTK_WIDGET_REALIZED(vtklock->window))
   {
-    SYSTEMUI_WARNING("failed to install dbus message filter");
+    gtk_style_set_background(vtklock->window->style, vtklock->window->window,
+                             GTK_STATE_NORMAL);
   }
-  else
-    vtklock->dbus_filter_installed = TRUE;
 }
 
-static void
-remove_dbus_handlers(vtklock_t *vtklock)
+static gboolean
+visual_tklock_snapshot_show(vtklock_t *vtklock)
 {
-  SYSTEMUI_DEBUG_FN;
+  gint width, height;
 
-  g_assert(vtklock->systemui_conn != NULL);
+  if (!vtklock->snapshot)
+    return FALSE;
+
+  /* rotated or resized since, the snapshot is of no use */
+  gdk_drawable_get_size(vtklock->snapshot, &width, &height);
+
+  if (width != gdk_screen_width() || height != gdk_screen_height())
+    return FALSE;
+
+  SYSTEMUI_DEBUG_FN;
+
+  gdk_window_set_back_pixmap(vtklock->window->window, vtklock->snapshot, FALSE);
+  vtklock->snapshot_shown = TRUE;
+
+  return TRUE;
+}
+
+/* the lock goes away, the snapshot is kept for the next one */
+static void
+visual_tklock_snapshot_cancel(vtklock_t *vtklock)
+{
+  if (vtklock->snapshot_id)
+  {
+    g_source_remove(vtklock->snapshot_id);
+    vtklock->snapshot_id = 0;
+  }
+
+  visual_tklock_snapshot_hide(vtklock);
+}
+
+static void
+visual_tklock_snapshot_drop(vtklock_t *vtklock)
+{
+  visual_tklock_snapshot_cancel(vtklock);
+
+  if (vtklock->snapshot)
+  {
+    g_object_unref(vtklock->snapshot);
+    vtklock->snapshot = NULL;
+  }
+}
+
+static gboolean
+visual_tklock_snapshot_cb(gpointer user_data)
+{
+  vtklock_t *vtklock = user_data;
+
+  vtklock->snapshot_id = 0;
+
+  if (!vtklock->window || !GTK_WIDGET_MAPPED(vtklock->window) ||
+      vtklock->paint_deferred || vtklock->snapshot_shown)
+  {
+    return FALSE;
+  }
+
+  SYSTEMUI_DEBUG_FN;
+
+  if (vtklock->snapshot)
+    g_object_unref(vtklock->snapshot);
+
+  vtklock->snapshot = gtk_widget_get_snapshot(vtklock->window, NULL);
+
+  return FALSE;
+}
+
+/* refresh the snapshot once there is nothing else to do */
+static void
+visual_tklock_snapshot_schedule(vtklock_t *vtklock)
+{
+  if (vtklock->snapshot || vtklock->snapshot_id)
+    return;
+
+  vtklock->snapshot_id = g_idle_add_full(G_PRIORITY_LOW,
+                                         visual_tklock_snapshot_cb, vtklock,
+                                         NULL);
+}
+
+static gboolean
+visual_tklock_expose_cb(GtkWidget *widget, GdkEventExpose *event,
+                        vtklock_t *vtklock)
+{
+  GdkRegion *live;
+
+  g_assert(vtklock != NULL);
+
+  /* do not paint anything while the display is off, see present_view */
+  if (vtklock->paint_deferred)
+    return TRUE;
+
+  if (!vtklock->snapshot_shown)
+    return FALSE;
+
+  /* X has already filled the window with the snapshot */
+  visual_tklock_snapshot_hide(vtklock);
+
+  live = gdk_region_new();
+  visual_tklock_damage_live(vtklock, live);
+  gdk_window_invalidate_region(widget->window, live, TRUE);
+  gdk_region_destroy(live);
+
+  return TRUE;
+}
+
+static void
+visual_tklock_size_request_cb(GtkWidget *widget, GtkRequisition *requisition,
+                              vtklock_t *vtklock)
+{
+  vtklock->size_requests++;
+}
+
+static void
+visual_tklock_start_timestamp_update(vtklock_t *vtklock)
+{
+  if (!vtklock->update_timestamp_id)
+  {
+    vtklock->update_timestamp_id =
+        g_timeout_add(1000, update_timestamp, vtklock);
+  }
+}
+
+void
+visual_tklock_present_view(vtklock_t *vtklock, gboolean deferred)
+{
+  gboolean events_changed;
+  gboolean slider_moved;
+  gboolean mapped;
+  GdkRegion *damage;
+
+  SYSTEMUI_DEBUG_FN;
+
+  g_assert(vtklock != NULL);
+
+  /*
+   * In deferred mode the window is mapped (and so grabs input) right away,
+   * but nothing gets painted until visual_tklock_paint_deferred() is called
+   * when the display is turned on.
+   */
+  vtklock->paint_deferred = deferred;
+
+  /* a reused window still shows the slider where the last unlock left it */
+  slider_moved = vtklock->slider_status == 4 || vtklock->slider_value != 3.0;
+
+  if (vtklock->slider || vtklock->render)
+    reset_slider(vtklock);
+
+  mapped = GTK_WIDGET_MAPPED(vtklock->window);
+
+  gtk_widget_realize(vtklock->window);
+
+  if (deferred)
+  {
+    gdk_flush();
+    ipm_show_window(vtklock->window, vtklock->priority);
+    return;
+  }
+
+  /*
+   * A window that was not mapped gets a full expose from X anyway, so only
+   * repaint what has changed if it stayed on screen since the last present.
+   */
+  damage = gdk_region_new();
+
+  /* window might have been kept hidden since the last present */
+  events_changed = get_missed_events_from_db(vtklock);
+
+  /* the snapshot shows the old event line */
+  if (events_changed)
+    visual_tklock_snapshot_drop(vtklock);
+
+  if (vtklock->render)
+  {
+    /* fixed layout, the renderer invalidates just the bands that changed */
+    if (events_changed)
+      tklock_render_set_events(vtklock->render, vtklock->event, event_idx);
+
+    set_timestamp(vtklock, NULL);
+  }
+  else if (events_changed)
+  {
+    damage_widget(damage, vtklock->content);
+    visual_tklock_destroy_view_content(vtklock);
+    visual_tklock_create_view_content(vtklock);
+  }
+  else
+  {
+    set_timestamp(vtklock, damage);
+
+    if (slider_moved)
+      damage_widget(damage, vtklock->slider);
+  }
+
+  if (!mapped)
+    visual_tklock_snapshot_show(vtklock);
+
+  gdk_flush();
+
+  ipm_show_window(vtklock->window, vtklock->priority);
+
+  if (mapped)
+    gdk_window_invalidate_region(vtklock->window->window, damage, TRUE);
+
+  gdk_region_destroy(damage);
+
+  /* paint the lock now, but leave the other windows for the idle update */
+  gdk_window_process_updates(vtklock->window->window, TRUE);
+  gdk_flush();
+
+  visual_tklock_start_timestamp_update(vtklock);
+  visual_tklock_snapshot_schedule(vtklock);
+}
+
+void
+visual_tklock_paint_deferred(vtklock_t *vtklock)
+{
+  gboolean events_changed;
+
+  SYSTEMUI_DEBUG_FN;
+
+  g_assert(vtklock != NULL);
+
+  if (!vtklock->paint_deferred || !vtklock->window)
+    return;
+
+  events_changed = get_missed_events_from_db(vtklock);
+
+  if (events_changed)
+    visual_tklock_snapshot_drop(vtklock);
+
+  if (vtklock->render)
+  {
+    if (events_changed)
+      tklock_render_set_events(vtklock->render, vtklock->event, event_idx);
+
+    set_timestamp(vtklock, NULL);
+  }
+  /* nothing was painted yet, so a changed event line can be rebuilt freely */
+  else if (events_changed)
+  {
+    visual_tklock_destroy_view_content(vtklock);
+    visual_tklock_create_view_content(vtklock);
+  }
+  else
+    set_timestamp(vtklock, NULL);
+
+  vtklock->paint_deferred = FALSE;
+
+  /* all exposes were swallowed while deferred, nothing is on screen yet */
+  gdk_window_invalidate_rect(vtklock->window->window, NULL, TRUE);
+  gdk_window_process_updates(vtklock->window->window, TRUE);
+  gdk_flush();
+
+  visual_tklock_start_timestamp_update(vtklock);
+  visual_tklock_snapshot_schedule(vtklock);
+}
+
+static int
+convert_str_to_index(const char *str)
+{
+  if (!strcmp("chat-message", str))
+    return 0;
+
+  if (!strcmp("sms-message", str))
+    return 0;
+
+  if (!strcmp("auth-request", str))
+    return 1;
+
+  if (!strcmp("chat-invitation", str))
+    return 2;
+
+  if (!strcmp("missed-call", str))
+    return 3;
+
+  if (!strcmp("email-message", str))
+    return 4;
+
+  if (!strcmp("voice-mail", str))
+    return 5;
+
+  SYSTEMUI_WARNING("Unknown string! return -1");
+
+  return -1;
+}
+
+static int
+get_missed_events_cb(void *user_data, int numcols, char **column_text,
+                     char **column_name)
+{
+  vtklock_t *vtklock = (vtklock_t *)user_data;
+  int index;
+
+  SYSTEMUI_DEBUG_FN;
+
+  g_assert(vtklock != NULL);
+
+  if (numcols != 3)
+  {
+    SYSTEMUI_WARNING("select returned error values count");
+    return -1;
+  }
+
+  if (!column_text[0] || !column_text[1] || !column_text[2])
+  {
+    SYSTEMUI_WARNING("select return error values");
+    return -1;
+  }
+
+  index = convert_str_to_index(column_text[0]);
+
+  if (index == -1)
+    return 0;
+
+  vtklock->event[index].hint = g_ascii_strtoll(column_text[1], NULL, 10);
+  vtklock->event[index].count += g_ascii_strtoll(column_text[2], NULL, 10);
+
+  event_count += vtklock->event[index].count;
+
+  return 0;
+}
+
+static gboolean
+get_missed_events_from_db(vtklock_t *vtklock)
+{
+  sqlite3 *pdb;
+  char *sql;
+  char *errmsg = NULL;
+  int i, j;
+  gchar *db_fname;
+  struct stat stat_buf;
+  gboolean changed = FALSE;
+
+  SYSTEMUI_DEBUG_FN;
+
+  memset(&stat_buf, 0, sizeof(stat_buf));
+
+  db_fname = g_build_filename(g_get_home_dir(),
+                              ".config/hildon-desktop/notifications.db", NULL);
+
+  if (db_fname)
+  {
+    if (stat(db_fname, &stat_buf))
+      SYSTEMUI_NOTICE("error in reading db file info [%s]", db_fname);
+  }
+  else
+    SYSTEMUI_ERROR("g_build_filename returned NULL");
+
+  if (vtklock->db_mtime == stat_buf.st_mtime)
+    goto out;
+
+  changed = TRUE;
+  event_count = 0;
+
+  for (i = 0; i < G_N_ELEMENTS(vtklock->event); i++)
+  {
+    vtklock->event[i].count = 0;
+    vtklock->event[i].hint = 0;
+    event_idx[i] = i;
+  }
+
+  if (!db_fname)
+    goto out;
+
+  if (sqlite3_open_v2(db_fname, &pdb, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK)
+  {
+    SYSTEMUI_WARNING("error in opening db [%s]", db_fname);
+    goto db_close_out;
+  }
+
+  sql = sqlite3_mprintf(
+        "SELECT H.value, H2.value, COUNT(*) "
+        "FROM notifications N, hints H, hints H2 "
+        "WHERE N.id=H.nid AND H.id='category' and H2.id = 'time' and H2.nid = H.nid "
+        "GROUP BY  H.value "
+        "ORDER BY H2.value;");
+
+  if (sqlite3_exec(
+        pdb, sql, get_missed_events_cb, vtklock, &errmsg) != SQLITE_OK)
+  {
+     SYSTEMUI_WARNING("Unable to get data about missed events from db: %s",
+                      errmsg);
+     sqlite3_free(errmsg);
+  }
+
+  sqlite3_free(sql);
+
+  /* Lame 'ORDER BY count DESC' loop */
+  for (i = 0; i < G_N_ELEMENTS(vtklock->event); i++)
+  {
+    for (j = i; j < G_N_ELEMENTS(vtklock->event); j++)
+    {
+      if (vtklock->event[i].count < vtklock->event[j].count)
+      {
+        guint tmp = event_idx[i];
+
+        event_idx[i] = event_idx[j];
+        event_idx[j] = tmp;
+      }
+    }
+  }
+
+  vtklock->db_mtime = stat_buf.st_mtime;
+
+db_close_out:
+  sqlite3_close(pdb);
+
+out:
+  g_free(db_fname);
+
+  return changed;
+}
+
+static DBusHandlerResult
+handle_time_changed(DBusConnection *connection, DBusMessage *message,
+                    void *user_data)
+{
+  vtklock_t *vtklock = user_data;
+
+  SYSTEMUI_DEBUG_FN;
+
+  if (dbus_message_get_type(message) == DBUS_MESSAGE_TYPE_SIGNAL &&
+      !g_strcmp0(dbus_message_get_member(message), CLOCKD_TIME_CHANGED))
+  {
+    g_assert(vtklock != NULL);
+
+    time_get_synced();
+    set_timestamp(vtklock, NULL);
+  }
+
+  return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+static void
+install_dbus_handlers(vtklock_t *vtklock)
+{
+  SYSTEMUI_DEBUG_FN;
+
+  g_assert(vtklock->systemui_conn != NULL);
+  g_assert(vtklock->dbus_filter_installed == FALSE);
+
+  dbus_bus_add_match(vtklock->systemui_conn, DBUS_CLOCKD_MATCH_RULE, NULL);
+
+  if (!dbus_connection_add_filter(vtklock->systemui_conn, handle_time_changed,
+                                  vtklock, NULL))
+  {
+    SYSTEMUI_WARNING("failed to install dbus message filter");
+  }
+  else
+    vtklock->dbus_filter_installed = TRUE;
+}
+
+static void
+remove_dbus_handlers(vtklock_t *vtklock)
+{
+  SYSTEMUI_DEBUG_FN;
+
+  g_assert(vtklock->systemui_conn != NULL);
 
   if (vtklock->dbus_filter_installed == FALSE)
     return;
@@ -434,7 +973,7 @@ visual_tklock_destroy_lock(vtklock_t *vtklock)
 {
   SYSTEMUI_DEBUG_FN;
 
-  if (!vtklock)
+  if (!vtklock || !vtklock->window)
     return;
 
   remove_dbus_handlers(vtklock);
@@ -445,24 +984,64 @@ visual_tklock_destroy_lock(vtklock_t *vtklock)
     vtklock->update_timestamp_id = 0;
   }
 
+  vtklock_drag_stats_remove(vtklock);
+  visual_tklock_snapshot_cancel(vtklock);
   gtk_grab_remove(vtklock->window);
   ipm_hide_window(vtklock->window);
+  tklock_render_destroy(vtklock->render);
+  vtklock->render = NULL;
+  visual_tklock_destroy_spare_layout(vtklock);
+
+  cancel_backgrounds(vtklock);
+
   gtk_widget_unrealize(vtklock->window);
   gtk_widget_destroy(vtklock->window);
   vtklock->slider_adjustment = NULL;
   vtklock->window = NULL;
+  vtklock->content = NULL;
+  vtklock->paint_deferred = FALSE;
   vtklock->ts.date_label = NULL;
   vtklock->ts.time_label = NULL;
   vtklock->slider = NULL;
 }
 
+void
+visual_tklock_hide_lock(vtklock_t *vtklock)
+{
+  SYSTEMUI_DEBUG_FN;
+
+  if (!vtklock || !vtklock->window)
+    return;
+
+  if (vtklock->update_timestamp_id)
+  {
+    g_source_remove(vtklock->update_timestamp_id);
+    vtklock->update_timestamp_id = 0;
+  }
+
+  vtklock_drag_stats_remove(vtklock);
+  visual_tklock_snapshot_cancel(vtklock);
+  gtk_grab_remove(vtklock->window);
+  ipm_hide_window(vtklock->window);
+}
+
 void
 visual_tklock_destroy(vtklock_t *vtklock)
 {
+  int i;
+
   if (!vtklock)
     return;
 
   visual_tklock_destroy_lock(vtklock);
+  visual_tklock_snapshot_drop(vtklock);
+
+  for (i = 0; i < G_N_ELEMENTS(vtklock->backgrounds); i++)
+  {
+    if (vtklock->backgrounds[i])
+      g_object_unref(vtklock->backgrounds[i]);
+  }
+
   g_slice_free(vtklock_t, vtklock);
 }
 
@@ -508,10 +1087,32 @@ visual_tklock_disable_lock(vtklock_t *vtklock)
     vtklock->update_timestamp_id = 0;
   }
 
+  visual_tklock_snapshot_cancel(vtklock);
   ipm_hide_window(vtklock->window);
   gtk_widget_unrealize(vtklock->window);
 }
 
+/* warm up the sqlite library and the page cache for the notifications db */
+void
+visual_tklock_prewarm_db()
+{
+  gchar *db_fname;
+  sqlite3 *pdb;
+
+  SYSTEMUI_DEBUG_FN;
+
+  db_fname = g_build_filename(g_get_home_dir(),
+                              ".config/hildon-desktop/notifications.db", NULL);
+
+  if (sqlite3_open_v2(db_fname, &pdb, SQLITE_OPEN_READONLY, NULL) == SQLITE_OK)
+  {
+    sqlite3_exec(pdb, "SELECT COUNT(*) FROM hints;", NULL, NULL, NULL);
+  }
+
+  sqlite3_close(pdb);
+  g_free(db_fname);
+}
+
 static void
 vtklock_window_set_no_transitions(GtkWidget *window)
 {
@@ -565,22 +1166,17 @@ make_timestamp_box(vtklockts *ts, gboolean portrait)
   pango_font_description_set_family(font_desc, "Nokia Sans");
   pango_font_description_set_absolute_size(font_desc, 75 * PANGO_SCALE);
 
-  time_label = gtk_label_new("");
+  time_label = tklock_clock_new(portrait);
+  tklock_clock_set_use_atlas(time_label, TRUE);
   gtk_widget_modify_font(time_label, font_desc);
 
-  date_label = gtk_label_new("");
+  date_label = tklock_clock_new(portrait);
   hildon_helper_set_logical_color(date_label, GTK_RC_FG, GTK_STATE_NORMAL,
                                   "SecondaryTextColor");
   hildon_helper_set_logical_color(date_label, GTK_RC_FG, GTK_STATE_PRELIGHT,
                                   "SecondaryTextColor");
   pango_font_description_free(font_desc);
 
-  if (portrait)
-  {
-    gtk_label_set_angle(GTK_LABEL(date_label), 270.0);
-    gtk_label_set_angle(GTK_LABEL(time_label), 270.0);
-  }
-
   gtk_box_pack_start(GTK_BOX(time_box), time_label, TRUE, TRUE, 0);
   gtk_box_pack_start(GTK_BOX(date_box), date_label, TRUE, TRUE, 0);
 
@@ -597,12 +1193,27 @@ make_timestamp_box(vtklockts *ts, gboolean portrait)
 
   ts->time_label = time_label;
   ts->date_label = date_label;
+  reserve_timestamp_extents(ts);
 
   return box;
 }
 
+static void
+gesture_slider_unlock_cb(gpointer user_data)
+{
+  vtklock_t *vtklock = user_data;
+
+  SYSTEMUI_DEBUG_FN;
+
+  vtklock->slider_status = 4;
+
+  if (vtklock->unlock_handler)
+    vtklock->unlock_handler();
+}
+
 static GtkWidget *
-visual_tklock_create_slider(gboolean portrait, gboolean rotated)
+visual_tklock_create_slider(vtklock_t *vtklock, gboolean portrait,
+                            gboolean rotated)
 {
   GtkWidget *slider;
   gint width;
@@ -616,6 +1227,9 @@ visual_tklock_create_slider(gboolean portrait, gboolean rotated)
 
   SYSTEMUI_DEBUG_FN;
 
+  if (vtklock->gesture_slider)
+    return tklock_slider_new(portrait, width, gesture_slider_unlock_cb, vtklock);
+
   slider = portrait ? hildon_gtk_vscale_new() : hildon_gtk_hscale_new();
   g_object_set(slider, "jump-to-position", FALSE, NULL);
 
@@ -634,22 +1248,56 @@ visual_tklock_create_slider(gboolean portrait, gboolean rotated)
   return slider;
 }
 
-static const char *
-get_icon_name(guint index)
-{
-  const char *icon_names[]={
-    "tasklaunch_sms_chat",
-    "tasklaunch_authorization_response",
-    "general_chatroom_invitation",
-    "general_application_call",
-    "general_email",
-    "tasklaunch_voice_mail",
-  };
-
-  if (index < G_N_ELEMENTS(icon_names))
-    return icon_names[index];
-  else
-    return NULL;
+static GdkPixbuf *event_icons[G_N_ELEMENTS(event_idx)];
+static gulong icon_theme_changed_id = 0;
+
+static void
+drop_event_icons()
+{
+  int i;
+
+  for (i = 0; i < G_N_ELEMENTS(event_icons); i++)
+  {
+    if (event_icons[i])
+    {
+      g_object_unref(event_icons[i]);
+      event_icons[i] = NULL;
+    }
+  }
+}
+
+static void
+icon_theme_changed_cb(GtkIconTheme *icon_theme, gpointer user_data)
+{
+  SYSTEMUI_DEBUG_FN;
+
+  drop_event_icons();
+}
+
+/* 48px event icon, loaded once, the caller gets a new reference */
+GdkPixbuf *
+visual_tklock_get_event_icon(guint index)
+{
+  GtkIconTheme *icon_theme = gtk_icon_theme_get_default();
+
+  g_return_val_if_fail(index < G_N_ELEMENTS(event_icons), NULL);
+
+  if (!icon_theme_changed_id)
+  {
+    icon_theme_changed_id =
+        g_signal_connect(icon_theme, "changed",
+                         G_CALLBACK(icon_theme_changed_cb), NULL);
+  }
+
+  if (!event_icons[index])
+  {
+    event_icons[index] =
+        gtk_icon_theme_load_icon(icon_theme,
+                                 tklock_get_icon_name(index), 48,
+                                 GTK_ICON_LOOKUP_NO_SVG, NULL);
+  }
+
+  return event_icons[index] ? g_object_ref(event_icons[index]) : NULL;
 }
 
 static GtkWidget *
@@ -660,7 +1308,7 @@ make_event_pair_box(int idx, int evcnt, gboolean portrait)
   PangoFontDescription *font;
   GdkPixbuf *pixbuf;
   GtkWidget *image;
-  const char *icon_name = get_icon_name(idx);
+  const char *icon_name = tklock_get_icon_name(idx);
 
   g_assert(icon_name != NULL);
 
@@ -676,8 +1324,7 @@ make_event_pair_box(int idx, int evcnt, gboolean portrait)
   gtk_widget_modify_font(count_label, font);
   pango_font_description_free(font);
 
-  pixbuf = gtk_icon_theme_load_icon(gtk_icon_theme_get_default(), icon_name,
-                                      48, GTK_ICON_LOOKUP_NO_SVG, NULL);
+  pixbuf = visual_tklock_get_event_icon(idx);
 
   if (portrait)
   {
@@ -739,96 +1386,448 @@ make_missed_events_line(vtklock_t *vtklock, gboolean portrait)
                        TRUE, TRUE, 0);
   }
 
-  if (portrait)
-    align = gtk_alignment_new(0.0, 0.5, 0.0, 0.0);
-  else
-    align = gtk_alignment_new(0.5, 0.0, 0.0, 0.0);
+  if (portrait)
+    align = gtk_alignment_new(0.0, 0.5, 0.0, 0.0);
+  else
+    align = gtk_alignment_new(0.5, 0.0, 0.0, 0.0);
+
+  gtk_container_add(GTK_CONTAINER(align), packer);
+
+  return align;
+}
+
+/* the prewarm fills it from its own thread */
+static GdkPixbuf *decoded_backgrounds[2];
+G_LOCK_DEFINE_STATIC(decoded_backgrounds);
+
+static const char *
+background_file(gboolean portrait)
+{
+  return portrait ? LOCKSLIDER_PORTRAIT_BACKGROUND : LOCKSLIDER_BACKGROUND;
+}
+
+/*
+ * decoded lockslider image, kept until a pixmap is made from it, the caller
+ * gets a new reference
+ */
+GdkPixbuf *
+visual_tklock_get_background(gboolean portrait)
+{
+  GdkPixbuf **cached = &decoded_backgrounds[portrait ? 1 : 0];
+  GdkPixbuf *pixbuf;
+
+  G_LOCK(decoded_backgrounds);
+  pixbuf = *cached ? g_object_ref(*cached) : NULL;
+  G_UNLOCK(decoded_backgrounds);
+
+  if (pixbuf)
+    return pixbuf;
+
+  /* not under the lock, a decode takes long */
+  pixbuf = gdk_pixbuf_new_from_file(background_file(portrait), NULL);
+
+  if (pixbuf)
+  {
+    G_LOCK(decoded_backgrounds);
+
+    if (!*cached)
+      *cached = g_object_ref(pixbuf);
+
+    G_UNLOCK(decoded_backgrounds);
+  }
+
+  return pixbuf;
+}
+
+/*
+ * decode the image in advance, unless a baked one will be used instead, safe
+ * to call from any thread, so no GDK here
+ */
+void
+visual_tklock_prewarm_background(gboolean portrait, gint width, gint height)
+{
+  GdkPixbuf *pixbuf;
+  int rotated;
+
+  for (rotated = FALSE; rotated <= TRUE; rotated++)
+  {
+    gchar *path = tklock_baked_path(background_file(portrait), rotated, width,
+                                    height);
+    gboolean baked = g_file_test(path, G_FILE_TEST_EXISTS);
+
+    g_free(path);
+
+    if (baked)
+      return;
+  }
+
+  pixbuf = visual_tklock_get_background(portrait);
+
+  if (pixbuf)
+    g_object_unref(pixbuf);
+}
+
+/*
+ * The pixmap is what the lock keeps, don't hold the decoded image (1.5 MB for
+ * 480x800) next to it. Another size or rotation decodes it again.
+ */
+static GdkPixbuf *
+take_background(gboolean portrait)
+{
+  GdkPixbuf *pixbuf = visual_tklock_get_background(portrait);
+  GdkPixbuf **cached = &decoded_backgrounds[portrait ? 1 : 0];
+
+  G_LOCK(decoded_backgrounds);
+
+  if (*cached)
+  {
+    g_object_unref(*cached);
+    *cached = NULL;
+  }
+
+  G_UNLOCK(decoded_backgrounds);
+
+  return pixbuf;
+}
+
+static GdkPixmap *
+make_background(gboolean portrait, gboolean fake, gint w, gint h)
+{
+  GdkPixbuf *pixbuf = NULL;
+  GdkPixmap *bg_pixmap;
+
+  SYSTEMUI_DEBUG_FN;
+
+  /* already scaled and in the server format, if installed */
+  bg_pixmap = tklock_baked_load(background_file(portrait), fake, w, h);
+
+  if (!bg_pixmap)
+    pixbuf = take_background(portrait);
+
+  if (pixbuf)
+  {
+    int pw = gdk_pixbuf_get_width(pixbuf);
+    int ph = gdk_pixbuf_get_height(pixbuf);
+
+    /* rotate and scale in one pass, without an intermediate copy */
+    if (fake || pw != w || ph != h)
+    {
+      GdkPixbuf *pixbuf_scaled = tklock_scale_rotate(pixbuf, w, h, fake);
+
+      g_object_unref(pixbuf);
+      pixbuf = pixbuf_scaled;
+    }
+
+    gdk_pixbuf_render_pixmap_and_mask(pixbuf, &bg_pixmap, NULL, 255);
+    g_object_unref(pixbuf);
+  }
+
+  return bg_pixmap;
+}
+
+/* background pixmap for a w x h screen, made once and then kept */
+static GdkPixmap *
+get_background(vtklock_t *vtklock, gboolean portrait, gboolean fake, gint w,
+               gint h)
+{
+  GdkPixmap **bg_pixmap = &vtklock->backgrounds[portrait ? 2 : fake ? 1 : 0];
+
+  if (*bg_pixmap)
+  {
+    gint pw, ph;
+
+    gdk_drawable_get_size(*bg_pixmap, &pw, &ph);
+
+    if (pw != w || ph != h)
+    {
+      g_object_unref(*bg_pixmap);
+      *bg_pixmap = NULL;
+    }
+  }
+
+  if (!*bg_pixmap)
+    *bg_pixmap = make_background(portrait, fake, w, h);
+
+  return *bg_pixmap;
+}
+
+static void
+fill_background(vtklock_t *vtklock, gboolean portrait, gboolean fake)
+{
+  GdkPixmap *bg_pixmap = get_background(vtklock, portrait, fake,
+                                        gdk_screen_width(),
+                                        gdk_screen_height());
+
+  if (bg_pixmap)
+  {
+    GtkStyle *style;
+
+    /* FIXME */
+    /*
+     * Could we use that:
+     * gdk_window_set_back_pixmap( GDK_WINDOW (window), pixMap, TRUE);
+     *
+     * also, do we really need to copy the style, gtk_style_new should to the job too.
+     *
+     * the pixmap stays resident while vtklock is not visible, until
+     * visual_tklock_trim() drops it
+     */
+    style = gtk_style_copy(gtk_rc_get_style(vtklock->window));
+    /* the style drops its reference when it goes, ours is kept */
+    style->bg_pixmap[0] = g_object_ref(bg_pixmap);
+    gtk_widget_set_style(vtklock->window, style);
+    g_object_unref(style);
+  }
+  else
+  {
+    /* FIXME - what is the real color value? */
+    GdkColor color = {0, 0, 0, 128};
+    gtk_widget_modify_bg(vtklock->window, GTK_STATE_NORMAL, &color);
+  }
+}
+
+static void
+background_job_unref(vtklock_background_job *job)
+{
+  if (g_atomic_int_dec_and_test(&job->ref))
+    g_slice_free(vtklock_background_job, job);
+}
+
+/* no GDK here, the image goes to the decoded_backgrounds cache */
+static gpointer
+decode_background_thread(gpointer user_data)
+{
+  vtklock_background_job *job = user_data;
+
+  visual_tklock_prewarm_background(job->portrait, job->width, job->height);
+  g_atomic_int_set(&job->done, 1);
+  background_job_unref(job);
+
+  return NULL;
+}
+
+/* the pixmap needs GDK, so it is made here once the thread has decoded */
+static gboolean
+prepare_backgrounds_cb(gpointer user_data)
+{
+  vtklock_t *vtklock = user_data;
+  vtklock_background_job *job = vtklock->backgrounds_job;
+
+  if (!g_atomic_int_get(&job->done))
+    return TRUE;
+
+  SYSTEMUI_DEBUG_FN;
+
+  vtklock->backgrounds_id = 0;
+  vtklock->backgrounds_job = NULL;
+  get_background(vtklock, job->portrait, FALSE, job->width, job->height);
+  background_job_unref(job);
+
+  return FALSE;
+}
+
+/*
+ * The other orientation image is made in advance, decoded by a thread that
+ * holds a reference of its own to the job, so the lock can go away meanwhile
+ * without waiting for it. If there is no thread, the first turn decodes it.
+ */
+static void
+prepare_backgrounds(vtklock_t *vtklock)
+{
+  vtklock_background_job *job;
+  GThread *thread;
+
+  if (vtklock->backgrounds_job)
+    return;
+
+  job = g_slice_new0(vtklock_background_job);
+  job->portrait = !vtklock->portrait;
+  job->width = gdk_screen_height();
+  job->height = gdk_screen_width();
+  job->ref = 2;
+
+  thread = g_thread_try_new("tklock-background", decode_background_thread, job,
+                            NULL);
+
+  if (!thread)
+  {
+    SYSTEMUI_WARNING("failed to start background thread");
+    g_slice_free(vtklock_background_job, job);
+    return;
+  }
+
+  g_thread_unref(thread);
+  vtklock->backgrounds_job = job;
+  vtklock->backgrounds_id = g_timeout_add_full(G_PRIORITY_LOW,
+                                               BACKGROUNDS_POLL,
+                                               prepare_backgrounds_cb,
+                                               vtklock, NULL);
+}
+
+static void
+cancel_backgrounds(vtklock_t *vtklock)
+{
+  if (!vtklock->backgrounds_job)
+    return;
+
+  g_source_remove(vtklock->backgrounds_id);
+  vtklock->backgrounds_id = 0;
+  background_job_unref(vtklock->backgrounds_job);
+  vtklock->backgrounds_job = NULL;
+}
+
+/*
+ * What a layout is built with on a w x h screen. With auto-rotation the
+ * window itself turns, so neither orientation is laid out as fake portrait.
+ */
+static void
+layout_flags(gboolean auto_rotation, gint width, gint height,
+             gboolean *fake_portrait, gboolean *rotated)
+{
+  *fake_portrait = !auto_rotation && height > width;
+  *rotated = auto_rotation;
+}
 
-  gtk_container_add(GTK_CONTAINER(align), packer);
+static void
+vtklock_layout_save(vtklock_t *vtklock, vtklock_layout *layout)
+{
+  layout->content = vtklock->content;
+  layout->ts = vtklock->ts;
+  layout->slider = vtklock->slider;
+  layout->slider_adjustment = vtklock->slider_adjustment;
+  layout->fake_portrait = vtklock->fake_portrait;
+  layout->rotated = vtklock->rotated;
+
+  vtklock->content = NULL;
+  vtklock->ts.time_label = NULL;
+  vtklock->ts.date_label = NULL;
+  vtklock->slider = NULL;
+  vtklock->slider_adjustment = NULL;
+}
 
-  return align;
+static void
+vtklock_layout_load(vtklock_t *vtklock, vtklock_layout *layout)
+{
+  vtklock->content = layout->content;
+  vtklock->ts = layout->ts;
+  vtklock->slider = layout->slider;
+  vtklock->slider_adjustment = layout->slider_adjustment;
+  vtklock->fake_portrait = layout->fake_portrait;
+  vtklock->rotated = layout->rotated;
+
+  memset(layout, 0, sizeof(*layout));
 }
 
 static void
-fill_background(vtklock_t *vtklock, gboolean portrait, gboolean fake)
+visual_tklock_destroy_spare_layout(vtklock_t *vtklock)
 {
-  GdkPixbuf *pixbuf;
-  GdkPixmap *bg_pixmap = NULL;
+  GtkWidget *content = vtklock->spare_layout.content;
 
-  if (portrait)
-    pixbuf = gdk_pixbuf_new_from_file(LOCKSLIDER_PORTRAIT_BACKGROUND, NULL);
-  else
-    pixbuf = gdk_pixbuf_new_from_file(LOCKSLIDER_BACKGROUND, NULL);
+  if (!content)
+    return;
 
-  if (pixbuf)
-  {
-    int pw = gdk_pixbuf_get_width(pixbuf);
-    int ph = gdk_pixbuf_get_height(pixbuf);
-    GdkScreen *screen = gdk_screen_get_default();
-    gint w = gdk_screen_get_width(screen);
-    gint h = gdk_screen_get_height(screen);
-    GtkStyle *style;
+  gtk_widget_destroy(content);
+  g_object_unref(content);
+  memset(&vtklock->spare_layout, 0, sizeof(vtklock->spare_layout));
+}
 
-    if (fake)
-    {
+/*
+ * Auto-rotation only. The layout of the orientation we leave is kept aside
+ * with the reference taken here, and swapped back in when the screen turns
+ * again, so after the first turn both layouts and both backgrounds are ready
+ * and a switch is a style change and a container swap, painted in one go.
+ */
+static void
+visual_tklock_set_orientation(vtklock_t *vtklock, gboolean portrait)
+{
+  vtklock_layout current;
 
-      GdkPixbuf *pixbuf_rotated;
+  if (vtklock->portrait == portrait)
+    return;
 
-      pixbuf_rotated = gdk_pixbuf_rotate_simple(pixbuf,
-                                                GDK_PIXBUF_ROTATE_CLOCKWISE);
-      g_object_unref(pixbuf);
-      pixbuf = pixbuf_rotated;
+  SYSTEMUI_DEBUG("switching to %s", portrait ? "portrait" : "landscape");
 
-    }
-    /* TODO - check the condition in portrait mode */
-    if (pw != w || ph != h)
-    {
-      GdkPixbuf *pixbuf_scaled =
-          gdk_pixbuf_scale_simple(pixbuf, w, h, GDK_INTERP_BILINEAR);
+  vtklock->portrait = portrait;
+  fill_background(vtklock, portrait, FALSE);
 
-      g_object_unref(pixbuf);
-      pixbuf = pixbuf_scaled;
-    }
+  if (!vtklock->content)
+    return;
 
-    gdk_pixbuf_render_pixmap_and_mask(pixbuf, &bg_pixmap, NULL, 255);
-    g_object_unref(pixbuf);
+  g_object_ref(vtklock->content);
+  gtk_container_remove(GTK_CONTAINER(vtklock->window), vtklock->content);
+  vtklock_layout_save(vtklock, &current);
 
-    /* FIXME */
-    /*
-     * Could we use that:
-     * gdk_window_set_back_pixmap( GDK_WINDOW (window), pixMap, TRUE);
-     *
-     * also, do we really need to copy the style, gtk_style_new should to the job too.
-     *
-     *the code bellow leads to ~1MB of memory usage even when vtklock is not visible
-     */
-    style = gtk_style_copy(gtk_rc_get_style(vtklock->window));
-    style->bg_pixmap[0] = bg_pixmap;
-    gtk_widget_set_style(vtklock->window, style);
-    g_object_unref(style);
+  if (vtklock->spare_layout.content)
+  {
+    vtklock_layout_load(vtklock, &vtklock->spare_layout);
+    gtk_container_add(GTK_CONTAINER(vtklock->window), vtklock->content);
+    g_object_unref(vtklock->content);
   }
   else
   {
-    /* FIXME - what is the real color value? */
-    GdkColor color = {0, 0, 0, 128};
-    gtk_widget_modify_bg(vtklock->window, GTK_STATE_NORMAL, &color);
+    /* only ever called with auto-rotation on */
+    layout_flags(TRUE, gdk_screen_width(), gdk_screen_height(),
+                 &vtklock->fake_portrait, &vtklock->rotated);
+    visual_tklock_create_view_content(vtklock);
   }
+
+  vtklock->spare_layout = current;
+
+  /* the spare one missed the clock ticks and the last unlock */
+  reset_slider(vtklock);
+  set_timestamp(vtklock, NULL);
 }
 
 static gboolean
 configure_event_cb(GtkWidget *widget, GdkEvent *event, gpointer data)
 {
+  vtklock_t *vtklock = data;
+  GdkEventConfigure *configure = &event->configure;
+
   g_return_val_if_fail(widget != NULL, FALSE);
   g_return_val_if_fail(event->type == GDK_CONFIGURE, FALSE);
   g_return_val_if_fail(data != NULL, FALSE);
 
-  fill_background((vtklock_t *)data, (gdk_screen_height() > gdk_screen_width()), FALSE);
+  /* a move, or the same size once again */
+  if (configure->width == vtklock->configure_width &&
+      configure->height == vtklock->configure_height)
+  {
+    return FALSE;
+  }
+
+  vtklock->configure_width = configure->width;
+  vtklock->configure_height = configure->height;
+
+  visual_tklock_set_orientation(vtklock, configure->height > configure->width);
+
+  /* the new style has reset the window background */
+  if (vtklock->snapshot_shown)
+  {
+    vtklock->snapshot_shown = FALSE;
+    visual_tklock_snapshot_show(vtklock);
+  }
+
+  if (vtklock->render)
+    tklock_render_relayout(vtklock->render);
 
   return FALSE;
 }
 
-void
-visual_tklock_create_view_whimsy(vtklock_t *vtklock)
+/* no widgets at all, everything is drawn into the window */
+static void
+visual_tklock_create_view_render(vtklock_t *vtklock)
+{
+  SYSTEMUI_DEBUG_FN;
+
+  vtklock->render = tklock_render_new(vtklock->window, vtklock->fake_portrait,
+                                      gesture_slider_unlock_cb, vtklock);
+  reset_slider(vtklock);
+  tklock_render_set_events(vtklock->render, vtklock->event, event_idx);
+  set_timestamp(vtklock, NULL);
+}
+
+static void
+visual_tklock_create_view_content(vtklock_t *vtklock)
 {
   GtkWidget *icon_packer_align = NULL;
   GtkWidget *label_align;
@@ -838,60 +1837,35 @@ visual_tklock_create_view_whimsy(vtklock_t *vtklock)
   GtkWidget *timestamp_packer_align;
   GtkWidget *label;
   GtkWidget *timestamp_packer;
-  gboolean force_fake_portrait;
-  gboolean rotated = FALSE;
+  gboolean force_fake_portrait = vtklock->fake_portrait;
   GtkRequisition sr;
-  GConfClient *gc;
 
   SYSTEMUI_DEBUG_FN;
 
-  if (vtklock->window)
-    return;
-
-  get_missed_events_from_db(vtklock);
-
-  force_fake_portrait = gdk_screen_height() > gdk_screen_width();
-
-  vtklock->window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
-  gtk_window_set_title(GTK_WINDOW(vtklock->window), "visual_tklock");
-  gtk_window_set_decorated(GTK_WINDOW(vtklock->window), FALSE);
-  gtk_window_set_keep_above(GTK_WINDOW(vtklock->window), TRUE);
-
-  gc = gconf_client_get_default();
+  g_assert(vtklock->window != NULL && vtklock->content == NULL);
 
-  /* check if autorotation is enabled */
-  if (gc && gconf_client_get_bool(gc, TKLOCK_AUTO_ROTATION, FALSE))
+  if (vtklock->cairo_renderer)
   {
-    /* Check if we have force_fake_portrait lockslider background */
-    if (!access(LOCKSLIDER_PORTRAIT_BACKGROUND, R_OK))
-    {
-      hildon_gtk_window_set_portrait_flags(GTK_WINDOW(vtklock->window),
-                                           HILDON_PORTRAIT_MODE_SUPPORT);
-      g_signal_connect(G_OBJECT(vtklock->window), "configure-event",
-                       G_CALLBACK(configure_event_cb), vtklock);
-      fill_background(vtklock, force_fake_portrait, FALSE);
-      force_fake_portrait = FALSE;
-      rotated = TRUE;
-    }
-    else
-      fill_background(vtklock, FALSE, force_fake_portrait);
-  }
-  else
-    fill_background(vtklock, FALSE, force_fake_portrait);
+    if (!vtklock->render)
+      visual_tklock_create_view_render(vtklock);
 
-  if (gc)
-    g_object_unref(gc);
+    return;
+  }
 
-  vtklock->slider = visual_tklock_create_slider(force_fake_portrait, rotated);
+  vtklock->slider = visual_tklock_create_slider(vtklock, force_fake_portrait,
+                                                vtklock->rotated);
   vtklock->slider_status = 1;
 
   slider_align = gtk_alignment_new(0.5, 0.5, 0.0, 0.0);
   gtk_container_add(GTK_CONTAINER(slider_align), vtklock->slider);
 
-  vtklock->slider_adjustment =
-      gtk_range_get_adjustment(GTK_RANGE(vtklock->slider));
+  if (GTK_IS_RANGE(vtklock->slider))
+  {
+    vtklock->slider_adjustment =
+        gtk_range_get_adjustment(GTK_RANGE(vtklock->slider));
 
-  g_assert(vtklock->slider_adjustment != NULL);
+    g_assert(vtklock->slider_adjustment != NULL);
+  }
 
   reset_slider(vtklock);
 
@@ -905,7 +1879,7 @@ visual_tklock_create_view_whimsy(vtklock_t *vtklock)
 
   g_assert(timestamp_packer != NULL);
 
-  update_timestamp(&vtklock->ts);
+  set_timestamp(vtklock, NULL);
 
   if (force_fake_portrait)
     timestamp_packer_align = gtk_alignment_new(0.0, 0.5, 0.0, 0.0);
@@ -963,15 +1937,15 @@ visual_tklock_create_view_whimsy(vtklock_t *vtklock)
 
   gtk_container_add(GTK_CONTAINER(window_align), label_packer);
   gtk_container_add(GTK_CONTAINER(vtklock->window), window_align);
+  vtklock->content = window_align;
 
-  g_signal_connect(vtklock->slider, "change-value",
-                   G_CALLBACK(change_value_cb), vtklock);
-  g_signal_connect(vtklock->slider, "value-changed",
-                   G_CALLBACK(value_changed_cb), vtklock);
-  g_signal_connect(vtklock->window, "key-press-event",
-                   G_CALLBACK(vtklock_key_press_event_cb), vtklock);
-  g_signal_connect(vtklock->window, "key-release-event",
-                   G_CALLBACK(vtklock_key_press_event_cb), vtklock);
+  if (vtklock->slider_adjustment)
+  {
+    g_signal_connect(vtklock->slider, "change-value",
+                     G_CALLBACK(change_value_cb), vtklock);
+    g_signal_connect(vtklock->slider, "value-changed",
+                     G_CALLBACK(value_changed_cb), vtklock);
+  }
 
   gtk_widget_show_all(window_align);
 
@@ -1019,6 +1993,100 @@ visual_tklock_create_view_whimsy(vtklock_t *vtklock)
                                 0);
     }
   }
+}
+
+static void
+visual_tklock_destroy_view_content(vtklock_t *vtklock)
+{
+  SYSTEMUI_DEBUG_FN;
+
+  /* made for the same events, so it is out of date too */
+  visual_tklock_destroy_spare_layout(vtklock);
+
+  if (!vtklock->content)
+    return;
+
+  gtk_widget_destroy(vtklock->content);
+  vtklock->content = NULL;
+  vtklock->slider_adjustment = NULL;
+  vtklock->ts.date_label = NULL;
+  vtklock->ts.time_label = NULL;
+  vtklock->slider = NULL;
+}
+
+void
+visual_tklock_create_view_whimsy(vtklock_t *vtklock)
+{
+  gboolean force_fake_portrait;
+  gboolean rotated = FALSE;
+  GConfClient *gc;
+
+  SYSTEMUI_DEBUG_FN;
+
+  if (vtklock->window)
+    return;
+
+  get_missed_events_from_db(vtklock);
+
+  force_fake_portrait = gdk_screen_height() > gdk_screen_width();
+
+  vtklock->window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+  gtk_window_set_title(GTK_WINDOW(vtklock->window), "visual_tklock");
+  gtk_window_set_decorated(GTK_WINDOW(vtklock->window), FALSE);
+  gtk_window_set_keep_above(GTK_WINDOW(vtklock->window), TRUE);
+
+  gc = gconf_client_get_default();
+
+  /* check if autorotation is enabled */
+  if (gc && gconf_client_get_bool(gc, TKLOCK_AUTO_ROTATION, FALSE))
+  {
+    /* Check if we have force_fake_portrait lockslider background */
+    if (!access(LOCKSLIDER_PORTRAIT_BACKGROUND, R_OK))
+    {
+      hildon_gtk_window_set_portrait_flags(GTK_WINDOW(vtklock->window),
+                                           HILDON_PORTRAIT_MODE_SUPPORT);
+      g_signal_connect(G_OBJECT(vtklock->window), "configure-event",
+                       G_CALLBACK(configure_event_cb), vtklock);
+      vtklock->portrait = force_fake_portrait;
+      vtklock->configure_width = 0;
+      vtklock->configure_height = 0;
+      fill_background(vtklock, force_fake_portrait, FALSE);
+      prepare_backgrounds(vtklock);
+      force_fake_portrait = FALSE;
+      rotated = TRUE;
+    }
+    else
+      fill_background(vtklock, FALSE, force_fake_portrait);
+  }
+  else
+    fill_background(vtklock, FALSE, force_fake_portrait);
+
+  if (gc)
+  {
+    vtklock->gesture_slider =
+        gconf_client_get_bool(gc, TKLOCK_GESTURE_SLIDER, NULL);
+    vtklock->drag_stats_enabled =
+        gconf_client_get_bool(gc, TKLOCK_DRAG_STATS, NULL);
+    vtklock->cairo_renderer =
+        gconf_client_get_bool(gc, TKLOCK_CAIRO_RENDERER, NULL);
+    g_object_unref(gc);
+  }
+
+  layout_flags(rotated, gdk_screen_width(), gdk_screen_height(),
+               &vtklock->fake_portrait, &vtklock->rotated);
+
+  visual_tklock_create_view_content(vtklock);
+
+  g_signal_connect(vtklock->window, "key-press-event",
+                   G_CALLBACK(vtklock_key_press_event_cb), vtklock);
+  g_signal_connect(vtklock->window, "key-release-event",
+                   G_CALLBACK(vtklock_key_press_event_cb), vtklock);
+  g_signal_connect(vtklock->window, "expose-event",
+                   G_CALLBACK(visual_tklock_expose_cb), vtklock);
+  g_signal_connect_after(vtklock->window, "map-event",
+                         G_CALLBACK(visual_tklock_map_cb), vtklock);
+  g_signal_connect(vtklock->window, "size-request",
+                   G_CALLBACK(visual_tklock_size_request_cb), vtklock);
 
   gtk_widget_realize(vtklock->window);
 
@@ -1035,3 +2103,137 @@ visual_tklock_create_view_whimsy(vtklock_t *vtklock)
 
   install_dbus_handlers(vtklock);
 }
+
+/* what X or the pixel data takes, X pads 24 bit pixels to 32 */
+static gsize
+drawable_bytes(GdkDrawable *drawable)
+{
+  gint w, h, depth;
+
+  if (!drawable)
+    return 0;
+
+  gdk_drawable_get_size(drawable, &w, &h);
+  depth = gdk_drawable_get_depth(drawable);
+
+  return (gsize)w * h * (depth > 16 ? 4 : depth > 8 ? 2 : 1);
+}
+
+static gsize
+pixbuf_bytes(GdkPixbuf *pixbuf)
+{
+  if (!pixbuf)
+    return 0;
+
+  return (gsize)gdk_pixbuf_get_rowstride(pixbuf) *
+      gdk_pixbuf_get_height(pixbuf);
+}
+
+/* bytes held by the lock screen graphics, vtklock may be NULL */
+void
+visual_tklock_get_memory(vtklock_t *vtklock, vtklock_memory *mem)
+{
+  guint i;
+
+  memset(mem, 0, sizeof(*mem));
+
+  G_LOCK(decoded_backgrounds);
+
+  for (i = 0; i < G_N_ELEMENTS(decoded_backgrounds); i++)
+    mem->decoded += pixbuf_bytes(decoded_backgrounds[i]);
+
+  G_UNLOCK(decoded_backgrounds);
+
+  for (i = 0; i < G_N_ELEMENTS(event_icons); i++)
+    mem->icons += pixbuf_bytes(event_icons[i]);
+
+  if (!vtklock)
+    return;
+
+  for (i = 0; i < G_N_ELEMENTS(vtklock->backgrounds); i++)
+    mem->background += drawable_bytes(vtklock->backgrounds[i]);
+
+  mem->snapshot = drawable_bytes(vtklock->snapshot);
+
+  /* hidden, but kept realized for the next lock */
+  if (vtklock->window && GTK_WIDGET_REALIZED(vtklock->window))
+  {
+    mem->windows++;
+    mem->window_bytes += drawable_bytes(vtklock->window->window);
+  }
+}
+
+/*
+ * Drop everything that is only kept to make the next lock faster. The
+ * decoded images left by the prewarm and the icons are only needed to build a
+ * lock, the pixmaps are kept while the lock window is still around. vtklock
+ * may be NULL.
+ */
+void
+visual_tklock_trim(vtklock_t *vtklock)
+{
+  guint i;
+
+  SYSTEMUI_DEBUG_FN;
+
+  if (vtklock && !vtklock->window)
+  {
+    visual_tklock_snapshot_drop(vtklock);
+
+    for (i = 0; i < G_N_ELEMENTS(vtklock->backgrounds); i++)
+    {
+      if (vtklock->backgrounds[i])
+      {
+        g_object_unref(vtklock->backgrounds[i]);
+        vtklock->backgrounds[i] = NULL;
+      }
+    }
+  }
+
+  G_LOCK(decoded_backgrounds);
+
+  for (i = 0; i < G_N_ELEMENTS(decoded_backgrounds); i++)
+  {
+    if (decoded_backgrounds[i])
+    {
+      g_object_unref(decoded_backgrounds[i]);
+      decoded_backgrounds[i] = NULL;
+    }
+  }
+
+  G_UNLOCK(decoded_backgrounds);
+
+  drop_event_icons();
+}
+
+static int
+visual_tklock_release_db_memory()
+{
+  /* the db is opened per query, only its page cache may be left behind */
+  return sqlite3_release_memory(G_MAXINT);
+}
+
+static const tklock_visual_ops visual_tklock_ops =
+{
+  visual_tklock_new,
+  visual_tklock_set_unlock_handler,
+  visual_tklock_create_view_whimsy,
+  visual_tklock_present_view,
+  visual_tklock_paint_deferred,
+  visual_tklock_hide_lock,
+  visual_tklock_destroy_lock,
+  visual_tklock_destroy,
+  visual_tklock_get_memory,
+  visual_tklock_trim,
+  visual_tklock_get_event_icon,
+  visual_tklock_prewarm_background,
+  visual_tklock_prewarm_db,
+  visual_tklock_release_db_memory
+};
+
+/* the only symbol the module exports */
+TKLOCK_EXPORT const tklock_visual_ops *
+tklock_visual_module_ops()
+{
+  return &visual_tklock_ops;
+}
@@ -11,8 +11,53 @@ typedef struct {
   guint hint;
 } event_t;
 
+/* widget tree for one orientation, see visual_tklock_set_orientation() */
+typedef struct {
+  GtkWidget *content;
+  vtklockts ts;
+  GtkWidget *slider;
+  GtkAdjustment *slider_adjustment;
+  /* what it was built with */
+  gboolean fake_portrait;
+  gboolean rotated;
+} vtklock_layout;
+
+/* the other orientation image, decoded by a thread */
+typedef struct {
+  gboolean portrait;
+  gint width;
+  gint height;
+  gint done;
+  gint ref;
+} vtklock_background_job;
+
+typedef struct {
+  guint count;
+  gint64 total_us;
+  gint64 max_us;
+} vtklock_time_stats;
+
+typedef struct {
+  guint drags;
+  vtklock_time_stats motion;
+  vtklock_time_stats paint;
+  vtklock_time_stats motion_to_paint;
+  gulong x_requests;
+} vtklock_drag_stats;
+
+/* resident bytes per kind of resource */
+typedef struct {
+  gsize background;
+  gsize decoded;
+  gsize icons;
+  gsize snapshot;
+  guint windows;
+  gsize window_bytes;
+} vtklock_memory;
+
 typedef struct {
   GtkWidget *window;
+  GtkWidget *content;
   vtklockts ts;
   GtkWidget *slider;
   guint slider_status;
@@ -27,14 +72,50 @@ typedef struct {
   gulong slider_change_value_id;
   gboolean dbus_filter_installed;
   time_t db_mtime;
+  gboolean fake_portrait;
+  gboolean rotated;
+  gboolean paint_deferred;
+  gboolean gesture_slider;
+  gboolean drag_stats_enabled;
+  gulong drag_event_hook;
+  gulong drag_event_after_hook;
+  gint64 drag_event_start[2];
+  gulong drag_event_request[2];
+  gint64 drag_motion_start;
+  vtklock_drag_stats drag_stats;
+  guint clock_ticks;
+  guint size_requests;
+  guint tick_size_requests;
+  gboolean cairo_renderer;
+  struct _tklock_render *render;
+  GdkPixmap *snapshot;
+  guint snapshot_id;
+  gboolean snapshot_shown;
+  gboolean portrait;
+  gint configure_width;
+  gint configure_height;
+  /* landscape, landscape rotated and portrait image */
+  GdkPixmap *backgrounds[3];
+  guint backgrounds_id;
+  vtklock_background_job *backgrounds_job;
+  vtklock_layout spare_layout;
 } vtklock_t;
 
-void visual_tklock_present_view(vtklock_t *vtklock);
+void visual_tklock_present_view(vtklock_t *vtklock, gboolean deferred);
+void visual_tklock_paint_deferred(vtklock_t *vtklock);
 vtklock_t *visual_tklock_new(DBusConnection *conn);
 void visual_tklock_destroy_lock(vtklock_t *vtklock);
+void visual_tklock_hide_lock(vtklock_t *vtklock);
 void visual_tklock_destroy(vtklock_t *vtklock);
 void visual_tklock_set_unlock_handler(vtklock_t *vtklock, void (*handler)());
 void visual_tklock_disable_lock(vtklock_t *vtklock);
 void visual_tklock_create_view_whimsy(vtklock_t *vtklock);
+GdkPixbuf *visual_tklock_get_event_icon(guint index);
+GdkPixbuf *visual_tklock_get_background(gboolean portrait);
+void visual_tklock_prewarm_background(gboolean portrait, gint width,
+                                      gint height);
+void visual_tklock_prewarm_db();
+void visual_tklock_get_memory(vtklock_t *vtklock, vtklock_memory *mem);
+void visual_tklock_trim(vtklock_t *vtklock);
 
 #endif /* __SYSTEMUI_VTKLOCK_H_INCLUDED__ */